@@ -4,6 +4,7 @@
 #include <string>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <filesystem>
 
@@ -24,7 +25,7 @@ App::App() = default;
 
 
 void App::initializeData() {
-    railMan.initializeData(datasetPath);
+    if (!railMan.useDataset(datasetPath)) railMan.loadDataset(datasetPath, datasetPath); // Loaded once per path
 }
 
 
@@ -118,6 +119,31 @@ void App::runMenu(const string &title, const vector<pair<char, string>> &options
     if (clearLast) clear_screen();
 }
 
+void App::printMinCut(const MinCut& cut) {
+    cout << " - Bottleneck Segments -\n";
+    for (const Segment& segment : cut.segments)
+        cout << segment.origin << " - " << segment.destination << " (" << segment.capacity << ", "
+             << (segment.service == ALFA_PENDULAR ? "ALFA PENDULAR" : "STANDARD") << ")\n";
+    if (cut.segments.empty()) cout << "None.\n";
+    cout << flush;
+}
+
+void App::showProgress(Cancellation& control) {
+    control.setProgressCallback([](size_t done, size_t total) {
+        cout << '\r' << vertical << " Progress: " << done << '/' << total << flush;
+    });
+}
+
+void App::printPartial(const Cancellation& control) {
+    if (control.interrupted()) cout << "(Time limit reached, partial result.)\n";
+}
+
+static Cancellation timeLimit(const string& seconds) {
+    double s = stod(seconds);
+    if (s <= 0) return {};
+    return Cancellation(chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(s)));
+}
+
 
 void App::start(){
     dataSelectionMenu();
@@ -166,6 +192,7 @@ void App::basicServiceMenu() {
             {'2', "Important Stations Pairs"},
             {'3', "Larger Budget Demanding Places"},
             {'4', "Max Number of Trains that Arrive at a Station"},
+            {'5', "Max Number of Trains that Arrive at Every Station"},
             {'x', "Back"}
     }, [this](char choice) -> bool {
         switch(choice){
@@ -173,6 +200,7 @@ void App::basicServiceMenu() {
             case '2': importantStationsOption(); break;
             case '3': largerBudgetPlacesOption(); break;
             case '4': maxFlowStationOption(); break;
+            case '5': stationsFlowReportOption(); break;
             case 'x': return false;
         }
         return true;
@@ -182,7 +210,7 @@ void App::basicServiceMenu() {
 void App::maxFlowOption() {
     string origin, destination;
     unordered_set<string> stationNames;
-    for (const auto& [name, _] : railMan.stations)
+    for (const auto& [name, _] : *railMan.stations)
         stationNames.insert(name);
     stationNames.insert("x"); // Cancel Option
     cin.ignore(); // Ignore \n char from previous choice.
@@ -191,12 +219,28 @@ void App::maxFlowOption() {
     destination = getLine("Destination Station (x to Cancel):", "Invalid Station Name. Try Again.", stationNames);
     if (destination == "x") return;
     cout << " - Max Flow between " << origin << " and " << destination << " -" << endl;
-    cout << "Max Flow: " << railMan.maxFlow(origin, destination) << endl;
+    auto [maxFlow, cut] = railMan.maxFlowCut(origin, destination);
+    cout << "Max Flow: " << maxFlow << endl;
+    printMinCut(cut);
+    if (railMan.datasets().size() < 2) return;
+    cout << "\n - Max Flow in Each Loaded Dataset -" << endl;
+    railMan.forEachDataset([this, &origin, &destination](const string& name) {
+        cout << name << ": ";
+        if (railMan.stationExists(origin) && railMan.stationExists(destination))
+            cout << railMan.maxFlow(origin, destination) << endl;
+        else cout << "Stations not in this dataset" << endl;
+    });
 }
 
 void App::importantStationsOption() {
+    string input = getDoubleString("Time Limit in Seconds (0 for None) (x to Cancel):", "Invalid Time. Try Again.", [](double x) -> bool { return x >= 0; });
+    if (input == "x") return;
+    Cancellation control = timeLimit(input);
+    showProgress(control);
     cout << " - Important Stations Pairs -" << endl;
-    auto [stations, maxFlow] = railMan.importantStations();
+    auto [stations, maxFlow] = railMan.importantStations(control);
+    cout << '\n';
+    printPartial(control);
     cout << "Max Flow: " << maxFlow << '\n';
     for (const auto& [stationA, stationB] : stations)
         cout << stationA << " - " << stationB << '\n';
@@ -210,11 +254,21 @@ void App::largerBudgetPlacesOption() {
     input = getDoubleString("Top k Districts (> 0) (x to Cancel):", "Invalid Number. Try Again.", [](double x) -> bool { return x > 0; });
     if (input == "x") return;
     int disK = ceil(stod(input));
+    input = getDoubleString("Time Limit in Seconds (0 for None) (x to Cancel):", "Invalid Time. Try Again.", [](double x) -> bool { return x >= 0; });
+    if (input == "x") return;
+    Cancellation control = timeLimit(input); // Shared by both rankings
+    showProgress(control);
     cout << " - Top " << munK << " Municipalities -" << endl;
-    for (const auto& [municipality, maxF] : railMan.topMunicipalities(munK))
+    auto municipalities = railMan.topMunicipalities(munK, control);
+    cout << '\n';
+    printPartial(control);
+    for (const auto& [municipality, maxF] : municipalities)
         cout << municipality << " - " << maxF << '\n';
     cout << "\n - Top " << disK << " Districts -" << endl;
-    for (const auto& [district, maxF] : railMan.topDistricts(disK))
+    auto districts = railMan.topDistricts(disK, control);
+    cout << '\n';
+    printPartial(control);
+    for (const auto& [district, maxF] : districts)
         cout << district << " - " << maxF << '\n';
     cout << flush;
 }
@@ -222,7 +276,7 @@ void App::largerBudgetPlacesOption() {
 void App::maxFlowStationOption() {
     string station;
     unordered_set<string> stationNames;
-    for (const auto& [name, _] : railMan.stations)
+    for (const auto& [name, _] : *railMan.stations)
         stationNames.insert(name);
     stationNames.insert("x"); // Cancel Option
     cin.ignore(); // Ignore \n char from previous choice.
@@ -232,6 +286,19 @@ void App::maxFlowStationOption() {
     cout << "Max Flow: " << railMan.maxFlowStation(station) << endl;
 }
 
+void App::stationsFlowReportOption() {
+    cout << " - Max Flow of Every Station -" << endl;
+    const size_t total = railMan.stations->size();
+    size_t done = 0;
+    auto report = railMan.stationsFlowReport([&done, total](const string&, unsigned) {
+        cout << '\r' << vertical << " Progress: " << ++done << '/' << total << flush;
+    });
+    cout << '\n';
+    for (const auto& [station, maxF] : report)
+        cout << station << " - " << maxF << '\n';
+    cout << flush;
+}
+
 
 // ========= //
 // COST MENU //
@@ -253,7 +320,7 @@ void App::costMenu() {
 void App::maxFlowMinCostOption() {
     string origin, destination;
     unordered_set<string> stationNames;
-    for (const auto& [name, _] : railMan.stations)
+    for (const auto& [name, _] : *railMan.stations)
         stationNames.insert(name);
     stationNames.insert("x"); // Cancel Option
     cin.ignore(); // Ignore \n char from previous choice.
@@ -262,7 +329,9 @@ void App::maxFlowMinCostOption() {
     destination = getLine("Destination Station (x to Cancel):", "Invalid Station Name. Try Again.", stationNames);
     if (destination == "x") return;
     cout << " - Max Flow with the Minimum Cost between " << origin << " and " << destination << " -" << endl;
-    cout << "Max Flow: " << railMan.maxFlowMinCost(origin, destination) << endl;
+    unsigned long long paths;
+    cout << "Max Flow: " << railMan.maxFlowMinCost(origin, destination, &paths) << endl;
+    cout << "Paths with the Minimum Cost: " << (paths == ULLONG_MAX ? "too many to count" : to_string(paths)) << endl;
 }
 
 
@@ -275,12 +344,14 @@ void App::reliabilityMenu() {
             {'1', "Max Flow for Reduced Connectivity"},
             {'2', "Most Sensitive Stations"},
             {'3', "Set Line and Station Failures"},
+            {'4', "Simulate Random Line and Station Failures"},
             {'x', "Back"}
     }, [this](char choice) -> bool {
         switch(choice){
             case '1': maxFlowReducedOption(); break;
             case '2': mostSensitiveStationsOption(); break;
             case '3': reducedSettingsMenu(); break;
+            case '4': failureSimulationOption(); break;
             case 'x': return false;
         }
         return true;
@@ -290,7 +361,7 @@ void App::reliabilityMenu() {
 void App::maxFlowReducedOption() {
     string origin, destination;
     unordered_set<string> stationNames;
-    for (const auto& [name, _] : railMan.stations)
+    for (const auto& [name, _] : *railMan.stations)
         stationNames.insert(name);
     stationNames.insert("x"); // Cancel Option
     cin.ignore(); // Ignore \n char from previous choice.
@@ -299,19 +370,62 @@ void App::maxFlowReducedOption() {
     destination = getLine("Destination Station (x to Cancel):", "Invalid Station Name. Try Again.", stationNames);
     if (destination == "x") return;
     cout << " - Max Flow of the Reduced Network between " << origin << " and " << destination << " -" << endl;
-    cout << "Max Flow: " << railMan.maxFlowReduced(origin, destination, segmentsToDeactivate, stationsToDeactivate) << endl;
+    auto [maxFlow, cut] = railMan.maxFlowReducedCut(origin, destination, Scenario(segmentsToDeactivate, stationsToDeactivate));
+    cout << "Max Flow: " << maxFlow << endl;
+    printMinCut(cut);
 }
 
 void App::mostSensitiveStationsOption() {
     string input = getDoubleString("Top k (> 0) (x to Cancel):", "Invalid Number. Try Again.", [](double x) -> bool { return x > 0; });
     if (input == "x") return;
     int k = ceil(stod(input));
+    input = getDoubleString("Time Limit in Seconds (0 for None) (x to Cancel):", "Invalid Time. Try Again.", [](double x) -> bool { return x >= 0; });
+    if (input == "x") return;
+    Cancellation control = timeLimit(input);
+    showProgress(control);
     cout << " - Top " << k << " Most Sensitive Stations (Biggest difference in flow) -" << endl;
-    for (const auto& [station, maxDiff] : railMan.topAffectedStations(k,segmentsToDeactivate,stationsToDeactivate))
+    auto stations = railMan.topAffectedStations(k, Scenario(segmentsToDeactivate, stationsToDeactivate), control);
+    cout << '\n';
+    printPartial(control);
+    for (const auto& [station, maxDiff] : stations)
         cout << station << " - " << maxDiff << '\n';
     cout << flush;
 }
 
+void App::failureSimulationOption() {
+    string origin, destination;
+    unordered_set<string> stationNames;
+    for (const auto& [name, _] : *railMan.stations)
+        stationNames.insert(name);
+    stationNames.insert("x"); // Cancel Option
+    cin.ignore(); // Ignore \n char from previous choice.
+    origin = getLine("Origin Station (x to Cancel):", "Invalid Station Name. Try Again.", stationNames);
+    if (origin == "x") return;
+    destination = getLine("Destination Station (x to Cancel):", "Invalid Station Name. Try Again.", stationNames);
+    if (destination == "x") return;
+    FailureModel model;
+    string input = getDoubleString("Segment Failure Probability [0, 1] (x to Cancel):", "Invalid Probability. Try Again.", [](double x) -> bool { return x >= 0 && x <= 1; });
+    if (input == "x") return;
+    model.segmentProbability = stod(input);
+    input = getDoubleString("Station Failure Probability [0, 1] (x to Cancel):", "Invalid Probability. Try Again.", [](double x) -> bool { return x >= 0 && x <= 1; });
+    if (input == "x") return;
+    model.stationProbability = stod(input);
+    input = getDoubleString("Number of Samples (> 0) (x to Cancel):", "Invalid Number. Try Again.", [](double x) -> bool { return x >= 1; });
+    if (input == "x") return;
+    auto samples = (unsigned long long) stod(input);
+    ReliabilityReport report = railMan.simulateFailures(origin, destination, model, samples);
+    cout << " - Max Flow between " << origin << " and " << destination << " over " << report.samples << " Samples -" << '\n'
+         << "Without Failures: " << report.intactFlow << '\n'
+         << "Mean: " << report.mean() << '\n'
+         << "Disconnected: " << report.disconnectedProbability() * 100 << "%\n";
+    for (double p : {1.0, 5.0, 25.0, 50.0, 75.0, 95.0, 99.0})
+        cout << "P" << p << ": " << report.percentile(p) << '\n';
+    cout << " - Distribution -\n";
+    for (const auto& [flow, count] : report.distribution)
+        cout << flow << " - " << (double) count / (double) report.samples * 100 << "%\n";
+    cout << flush;
+}
+
 void App::reducedSettingsMenu() {
     runMenu("Line and Station Failures", {
             {'1', "Toggle Affected Segments"},
@@ -326,7 +440,7 @@ void App::reducedSettingsMenu() {
             case '1': { // Toggle Affected Segments
                 string stationA, stationB;
                 unordered_set<string> stationNames;
-                for (const auto& [name, _] : railMan.stations)
+                for (const auto& [name, _] : *railMan.stations)
                     stationNames.insert(name);
                 stationNames.insert("x"); // Cancel Option
                 cin.ignore(); // Ignore \n char from previous choice.
@@ -351,7 +465,7 @@ void App::reducedSettingsMenu() {
             case '2': { // Toggle Affected Stations
                 string station;
                 unordered_set<string> stationNames;
-                for (const auto& [name, _] : railMan.stations)
+                for (const auto& [name, _] : *railMan.stations)
                     stationNames.insert(name);
                 stationNames.insert("x"); // Cancel Option
                 cin.ignore(); // Ignore \n char from previous choice.
@@ -410,7 +524,10 @@ void App::dataSelectionMenu() {
         const string projectPath = filesystem::current_path().parent_path().string() + '\\';
         string text = string("Current Path: ") + projectPath;
         cout << "\n" << getTitle(title) << string(spaceBetween, ' ') << '\n'
-             << vertical << ' ' << text << '\n' << getBottomLine() << endl;
+             << vertical << ' ' << text << '\n';
+        for (const string& name : railMan.datasets()) // Picking one of these again switches to it without reloading
+            cout << vertical << " Loaded: " << name << '\n';
+        cout << getBottomLine() << endl;
 
         string pathChosen;
         while (true){
@@ -92,6 +92,21 @@ class App {
      * @param const std::vector<std::string>& options
      */
     static void drawMenu(const std::string& title, const std::vector<std::string>& options);
+    /**
+     * Prints the bottleneck segments of a max flow query.
+     * @param const MinCut& cut
+     */
+    static void printMinCut(const MinCut& cut);
+    /**
+     * Prints the progress of a long query on a single line.
+     * @param Cancellation& control
+     */
+    static void showProgress(Cancellation& control);
+    /**
+     * Warns that a query ran out of time and that its result is partial.
+     * @param const Cancellation& control
+     */
+    static void printPartial(const Cancellation& control);
     /**
      * Main Menu. (Calls runMenu)
      */
@@ -108,6 +123,7 @@ class App {
     void importantStationsOption();
     void largerBudgetPlacesOption();
     void maxFlowStationOption();
+    void stationsFlowReportOption();
     /**
      * Cost Menu. (Calls runMenu)
      */
@@ -119,6 +135,7 @@ class App {
     void reliabilityMenu();
     void maxFlowReducedOption();
     void mostSensitiveStationsOption();
+    void failureSimulationOption();
     void reducedSettingsMenu();
     template <typename Lambda>
     /**
@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <climits>
+#include <set>
+#include <tuple>
+
+#include "BlockIndex.h"
+#include "RailNetwork.h"
+
+using namespace std;
+
+
+unsigned long long BlockIndex::edgeKey(unsigned a, unsigned b) {
+    if (a > b) swap(a, b);
+    return ((unsigned long long) a << 32) | b;
+}
+
+BlockIndex::BlockIndex(const RailNetwork &network) {
+    // Undirected simple graph
+    vector<set<unsigned>> neighbours;
+    for (const auto& [name, node] : network.nodes)
+        if (ids.emplace(name, ids.size()).second) neighbours.emplace_back();
+    for (const auto& [name, node] : network.nodes)
+        for (const auto& edge : node.adj) {
+            auto it = ids.find(*edge.dest);
+            if (it == ids.end() || it->second == ids.at(name)) continue;
+            neighbours[ids.at(name)].insert(it->second);
+            neighbours[it->second].insert(ids.at(name));
+        }
+    const unsigned n = neighbours.size();
+
+    // Tarjan's biconnected components, iteratively
+    vector<unsigned> disc(n, 0), low(n, 0);
+    vector<vector<unsigned>> blocks;
+    vector<pair<unsigned, unsigned>> edgeStack;
+    vector<unsigned> mark(n, UINT_MAX);
+    articulation.assign(n, false);
+    unsigned timer = 0;
+    auto popBlock = [&](unsigned v, unsigned w) {
+        unsigned block = blocks.size();
+        blocks.emplace_back();
+        while (true) {
+            auto [a, b] = edgeStack.back();
+            edgeStack.pop_back();
+            edgeBlock[edgeKey(a, b)] = block;
+            for (unsigned x : {a, b})
+                if (mark[x] != block) {
+                    mark[x] = block;
+                    blocks.back().push_back(x);
+                }
+            if (a == v && b == w) break;
+        }
+    };
+    for (unsigned root = 0; root < n; root++) {
+        if (disc[root] != 0) continue;
+        disc[root] = low[root] = ++timer;
+        if (neighbours[root].empty()) {
+            blocks.push_back({root});
+            continue;
+        }
+        unsigned rootChildren = 0;
+        vector<tuple<unsigned, unsigned, set<unsigned>::const_iterator>> frames{{root, UINT_MAX, neighbours[root].begin()}};
+        while (!frames.empty()) {
+            auto& [v, parent, it] = frames.back();
+            if (it != neighbours[v].end()) {
+                unsigned w = *it++;
+                if (disc[w] == 0) {
+                    edgeStack.emplace_back(v, w);
+                    disc[w] = low[w] = ++timer;
+                    if (v == root) rootChildren++;
+                    frames.emplace_back(w, v, neighbours[w].begin());
+                } else if (w != parent && disc[w] < disc[v]) {
+                    edgeStack.emplace_back(v, w);
+                    low[v] = min(low[v], disc[w]);
+                }
+                continue;
+            }
+            unsigned w = v, p = parent;
+            frames.pop_back();
+            if (p == UINT_MAX) break;
+            low[p] = min(low[p], low[w]);
+            if (low[w] >= disc[p]) {
+                if (p != root) articulation[p] = true;
+                popBlock(p, w);
+            }
+        }
+        if (rootChildren > 1) articulation[root] = true;
+    }
+
+    // Block-cut forest: blocks first, then one node per articulation point
+    const unsigned b = blocks.size();
+    vector<vector<unsigned>> tree(b);
+    treeNode.assign(n, 0);
+    stationBlocks.assign(n, {});
+    vector<unsigned> cutNode(n, UINT_MAX);
+    for (unsigned v = 0; v < n; v++)
+        if (articulation[v]) {
+            cutNode[v] = tree.size();
+            treeNode[v] = tree.size();
+            tree.emplace_back();
+        }
+    for (unsigned block = 0; block < b; block++) {
+        for (unsigned v : blocks[block]) {
+            stationBlocks[v].push_back(block);
+            if (articulation[v]) {
+                tree[block].push_back(cutNode[v]);
+                tree[cutNode[v]].push_back(block);
+            } else treeNode[v] = block;
+        }
+        if (blocks[block].size() == 2 && edgeBlock.count(edgeKey(blocks[block][0], blocks[block][1])))
+            bridges.emplace_back(blocks[block][0], blocks[block][1]);
+        else bridges.emplace_back(UINT_MAX, UINT_MAX);
+    }
+
+    // Euler tour of every tree
+    const unsigned t = tree.size();
+    depth.assign(t, 0);
+    tin.assign(t, 0);
+    tout.assign(t, 0);
+    component.assign(t, 0);
+    firstVisit.assign(t, 0);
+    vector<unsigned> euler;
+    vector<bool> seen(t, false);
+    timer = 0;
+    for (unsigned root = 0; root < t; root++) {
+        if (seen[root]) continue;
+        seen[root] = true;
+        vector<pair<unsigned, unsigned>> frames{{root, 0}};
+        tin[root] = timer++;
+        firstVisit[root] = euler.size();
+        euler.push_back(root);
+        while (!frames.empty()) {
+            auto& [v, next] = frames.back();
+            component[v] = root;
+            if (next < tree[v].size()) {
+                unsigned w = tree[v][next++];
+                if (seen[w]) continue;
+                seen[w] = true;
+                depth[w] = depth[v] + 1;
+                tin[w] = timer++;
+                firstVisit[w] = euler.size();
+                euler.push_back(w);
+                frames.emplace_back(w, 0);
+                continue;
+            }
+            tout[v] = timer++;
+            frames.pop_back();
+            if (!frames.empty()) euler.push_back(frames.back().first);
+        }
+    }
+    sparse.push_back(euler);
+    for (size_t len = 2; len <= euler.size(); len *= 2) {
+        const vector<unsigned>& prev = sparse.back();
+        vector<unsigned> level(euler.size() - len + 1);
+        for (size_t i = 0; i < level.size(); i++) {
+            unsigned x = prev[i], y = prev[i + len / 2];
+            level[i] = depth[x] <= depth[y] ? x : y;
+        }
+        sparse.push_back(std::move(level));
+    }
+}
+
+bool BlockIndex::empty() const {
+    return ids.empty();
+}
+
+bool BlockIndex::isAncestor(unsigned ancestor, unsigned node) const {
+    return tin[ancestor] <= tin[node] && tout[node] <= tout[ancestor];
+}
+
+unsigned BlockIndex::lca(unsigned a, unsigned b) const {
+    unsigned l = firstVisit[a], r = firstVisit[b];
+    if (l > r) swap(l, r);
+    unsigned level = 0;
+    while ((2u << level) <= r - l + 1) level++;
+    unsigned x = sparse[level][l], y = sparse[level][r + 1 - (1u << level)];
+    return depth[x] <= depth[y] ? x : y;
+}
+
+bool BlockIndex::onPath(unsigned node, unsigned a, unsigned b) const {
+    if (component[node] != component[a] || component[a] != component[b]) return false;
+    return isAncestor(lca(a, b), node) && (isAncestor(node, a) || isAncestor(node, b));
+}
+
+bool BlockIndex::segmentBlock(const string &origin, const string &destination, unsigned &block) const {
+    auto a = ids.find(origin), b = ids.find(destination);
+    if (a == ids.end() || b == ids.end()) return false;
+    auto it = edgeBlock.find(edgeKey(a->second, b->second));
+    if (it == edgeBlock.end()) return false;
+    block = it->second;
+    return true;
+}
+
+bool BlockIndex::isArticulation(const string &station) const {
+    auto it = ids.find(station);
+    return it != ids.end() && articulation[it->second];
+}
+
+bool BlockIndex::isBridge(const string &origin, const string &destination) const {
+    unsigned block;
+    return segmentBlock(origin, destination, block) && bridges[block].first != UINT_MAX;
+}
+
+bool BlockIndex::separated(const string &origin, const string &destination, const Scenario &scenario) const {
+    auto o = ids.find(origin), d = ids.find(destination);
+    if (o == ids.end() || d == ids.end() || o->second == d->second) return false;
+    unsigned a = treeNode[o->second], b = treeNode[d->second];
+    if (component[a] != component[b]) return true;
+    if (scenario.stationDisabled(destination)) return true;
+    for (const string& station : scenario.stations) {
+        auto it = ids.find(station);
+        if (it != ids.end() && it->second != o->second && articulation[it->second] && onPath(treeNode[it->second], a, b))
+            return true;
+    }
+    for (const auto& [from, destinations] : scenario.segments)
+        for (const string& to : destinations) {
+            unsigned block;
+            if (!segmentBlock(from, to, block) || bridges[block].first == UINT_MAX || !onPath(block, a, b)) continue;
+            if (sameSide(from, to, origin)) return true; // Crossing the bridge in the direction that is out of service
+        }
+    return false;
+}
+
+bool BlockIndex::touches(const list<string> &origins, const string &destination, const Scenario &scenario) const {
+    auto d = ids.find(destination);
+    if (d == ids.end()) return true;
+    vector<unsigned> starts;
+    for (const string& origin : origins) {
+        auto o = ids.find(origin);
+        if (o == ids.end()) return true;
+        starts.push_back(treeNode[o->second]);
+    }
+    unsigned b = treeNode[d->second];
+    auto relevant = [&](unsigned node) {
+        for (unsigned a : starts)
+            if (onPath(node, a, b)) return true;
+        return false;
+    };
+    for (const string& station : scenario.stations) { // An articulation point is in several blocks
+        auto it = ids.find(station);
+        if (it == ids.end()) continue;
+        for (unsigned block : stationBlocks[it->second])
+            if (relevant(block)) return true;
+    }
+    for (const auto& [from, destinations] : scenario.segments)
+        for (const string& to : destinations) {
+            unsigned block;
+            if (segmentBlock(from, to, block) && relevant(block)) return true;
+        }
+    return false;
+}
+
+list<pair<pair<string, string>, vector<bool>>> BlockIndex::bridgeSides(const vector<const string*> &stations) const {
+    list<pair<pair<string, string>, vector<bool>>> res;
+    if (empty()) return res;
+    vector<const string*> names(ids.size());
+    for (const auto& [name, id] : ids) names[id] = &name;
+    vector<unsigned> nodes;
+    for (const string* station : stations) {
+        auto it = ids.find(*station);
+        nodes.push_back(it == ids.end() ? UINT_MAX : it->second);
+    }
+    for (unsigned block = 0; block < bridges.size(); block++) {
+        const auto [a, b] = bridges[block];
+        if (a == UINT_MAX) continue;
+        for (const auto& [end, other] : {make_pair(a, b), make_pair(b, a)}) {
+            vector<bool> side(stations.size(), true);
+            for (size_t i = 0; i < stations.size(); i++)
+                if (nodes[i] != UINT_MAX && nodes[i] != end) side[i] = !onPath(block, treeNode[nodes[i]], treeNode[end]);
+            res.emplace_back(make_pair(*names[end], *names[other]), std::move(side));
+        }
+    }
+    return res;
+}
+
+bool BlockIndex::sameSide(const string &end, const string &other, const string &station) const {
+    unsigned block;
+    if (station == end || !segmentBlock(end, other, block)) return true;
+    auto it = ids.find(station);
+    if (it == ids.end()) return true;
+    return !onPath(block, treeNode[it->second], treeNode[ids.at(end)]);
+}
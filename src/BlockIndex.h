@@ -0,0 +1,132 @@
+#ifndef RAILNETWORK_BLOCKINDEX_H
+#define RAILNETWORK_BLOCKINDEX_H
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Scenario.h"
+
+class RailNetwork;
+
+/**
+ * @brief The biconnected blocks of a rail network, its bridges and articulation points, built once per load.
+ * Segments are taken as undirected. The blocks and articulation points form a forest (the block-cut tree), and any
+ * simple path between two stations only goes through the blocks on the tree path between them. So a failure outside
+ * those blocks can't change the flow between the stations, and a failed articulation point or bridge on it disconnects
+ * them. Tree paths are checked in O(1) with an Euler tour and a sparse table of lowest common ancestors.
+ */
+class BlockIndex {
+    std::unordered_map<std::string, unsigned> ids;
+    std::vector<unsigned> treeNode; // Of each station: its articulation node, or the only block it's in
+    std::vector<std::vector<unsigned>> stationBlocks; // Of each station: every block it's in
+    std::vector<bool> articulation;
+    std::unordered_map<unsigned long long, unsigned> edgeBlock;
+    std::vector<std::pair<unsigned, unsigned>> bridges; // Of each block that is a bridge, its two stations
+    std::vector<unsigned> depth, tin, tout, component, firstVisit;
+    std::vector<std::vector<unsigned>> sparse; // Euler tour minimums by depth, for lowest common ancestors
+    /**
+     * @brief Returns the key of the undirected edge between two stations.
+     * @param a The id of a station.
+     * @param b The id of the other station.
+     * @return The key.
+     */
+    static unsigned long long edgeKey(unsigned a, unsigned b);
+    /**
+     * @brief Checks if a tree node is an ancestor of (or the same as) another.
+     * @param ancestor The possible ancestor.
+     * @param node The node.
+     * @return True if it's an ancestor.
+     */
+    bool isAncestor(unsigned ancestor, unsigned node) const;
+    /**
+     * @brief Returns the lowest common ancestor of two tree nodes of the same tree.
+     * @param a A tree node.
+     * @param b The other tree node.
+     * @return The lowest common ancestor.
+     */
+    unsigned lca(unsigned a, unsigned b) const;
+    /**
+     * @brief Checks if a tree node is on the tree path between two others (ends included).
+     * @param node The tree node.
+     * @param a One end of the path.
+     * @param b The other end of the path.
+     * @return True if it's on the path.
+     */
+    bool onPath(unsigned node, unsigned a, unsigned b) const;
+    /**
+     * @brief Returns the block of the segment between two stations.
+     * @param origin The name of a station.
+     * @param destination The name of the other station.
+     * @param block Where to store the block.
+     * @return False if there is no such segment.
+     */
+    bool segmentBlock(const std::string& origin, const std::string& destination, unsigned& block) const;
+    /**
+     * @brief Checks if a station is on the same side of a bridge as one of its ends.
+     * @param end The name of the station at that end of the bridge.
+     * @param other The name of the station at the other end.
+     * @param station The name of the station.
+     * @return True if the station can reach the end without crossing the bridge (or isn't connected to it at all).
+     */
+    bool sameSide(const std::string& end, const std::string& other, const std::string& station) const;
+public:
+    /**
+     * @brief Default constructor. Creates an empty index, which knows nothing about any station.
+     */
+    BlockIndex() = default;
+    /**
+     * @brief Builds the index of a network with Tarjan's algorithm.
+     * @param network The network.
+     */
+    explicit BlockIndex(const RailNetwork& network);
+    /**
+     * @brief Checks if the index was built.
+     * @return True if the index is empty.
+     */
+    bool empty() const;
+    /**
+     * @brief Checks if a station is an articulation point, i.e. if its failure disconnects the network.
+     * @param station The name of the station.
+     * @return True if it's an articulation point.
+     */
+    bool isArticulation(const std::string& station) const;
+    /**
+     * @brief Checks if a segment is a bridge, i.e. if its failure disconnects the network.
+     * @param origin The name of a station.
+     * @param destination The name of the other station.
+     * @return True if it's a bridge.
+     */
+    bool isBridge(const std::string& origin, const std::string& destination) const;
+    /**
+     * @brief Checks if a scenario leaves no way from the origin to the destination: they aren't connected, the
+     * destination is out of service, or an articulation point or a bridge (in the direction of travel) between them is.
+     * @param origin The name of the origin station.
+     * @param destination The name of the destination station.
+     * @param scenario The stations and segments out of service.
+     * @return True if they are surely disconnected, false if they might not be.
+     */
+    bool separated(const std::string& origin, const std::string& destination, const Scenario& scenario) const;
+    /**
+     * @brief Checks if a scenario takes out any station or segment in the blocks between some origin and the
+     * destination. If not, no flow from those origins to the destination can change.
+     * @param origins The names of the origin stations.
+     * @param destination The name of the destination station.
+     * @param scenario The stations and segments out of service.
+     * @return False if the scenario surely doesn't affect the flows, true if it might.
+     */
+    bool touches(const std::list<std::string>& origins, const std::string& destination, const Scenario& scenario) const;
+    /**
+     * @brief Returns the sides of every bridge. Any flow from one side of a bridge to the other is bounded by the
+     * capacity of the bridge in that direction.
+     * @param stations The names of the stations to place on the sides.
+     * @return For each bridge, in each direction, its stations and which of the given stations can reach its first
+     * station without crossing it (or aren't connected to it at all).
+     */
+    std::list<std::pair<std::pair<std::string, std::string>, std::vector<bool>>> bridgeSides(const std::vector<const std::string*>& stations) const;
+};
+
+
+#endif //RAILNETWORK_BLOCKINDEX_H
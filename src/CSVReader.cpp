@@ -13,6 +13,7 @@ CSV CSVReader::read(const string& file){
     CSV out;
     string line;
     while(getline(in, line)){
+        if (!line.empty() && line.back() == '\r') line.pop_back(); // Files saved with CRLF line endings
         istringstream iss (line);
         CSVLine csvLine;
         string str;
@@ -0,0 +1,81 @@
+#ifndef RAILNETWORK_CANCELLATION_H
+#define RAILNETWORK_CANCELLATION_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <utility>
+
+/**
+ * @brief Cooperative cancellation and deadline for long analyses.
+ * Long queries poll stop() between flow augmentations and pair/station/region iterations. Once it returns true they
+ * return their best result so far, and interrupted() tells the caller that the result is partial.
+ */
+class Cancellation {
+    std::atomic<bool> cancelled;
+    mutable std::atomic<bool> stopped;
+    std::chrono::steady_clock::time_point deadline;
+    std::function<void(size_t, size_t)> onProgress;
+public:
+    /**
+     * @brief Constructs a control that never expires (until cancelled).
+     */
+    Cancellation() : cancelled(false), stopped(false), deadline(std::chrono::steady_clock::time_point::max()) {}
+    /**
+     * @brief Constructs a control that expires after the given time.
+     * @param timeout The time the query is allowed to run for.
+     */
+    explicit Cancellation(std::chrono::steady_clock::duration timeout) : Cancellation() {
+        deadline = std::chrono::steady_clock::now() + timeout;
+    }
+    /**
+     * @brief Sets the function called with (done, total) as a query makes progress. It may be called from workers.
+     * @param callback The progress callback.
+     */
+    void setProgressCallback(std::function<void(size_t, size_t)> callback) {
+        onProgress = std::move(callback);
+    }
+    /**
+     * @brief Asks the query to stop as soon as possible. Can be called from any thread.
+     */
+    void cancel() {
+        cancelled = true;
+    }
+    /**
+     * @brief Checks if the query should stop (cancelled or past its deadline), remembering it if so.
+     * @return True if the query should stop.
+     */
+    bool stop() const {
+        if (stopped) return true;
+        if (cancelled || (deadline != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= deadline))
+            stopped = true;
+        return stopped;
+    }
+    /**
+     * @brief Checks if a query had to stop early, i.e. if its result is partial.
+     * @return True if the result is partial.
+     */
+    bool interrupted() const {
+        return stopped;
+    }
+    /**
+     * @brief Reports the progress of the query.
+     * @param done The number of units of work done.
+     * @param total The total number of units of work.
+     */
+    void progress(size_t done, size_t total) const {
+        if (onProgress) onProgress(done, total);
+    }
+    /**
+     * @brief A shared control that never stops, used by queries called without one.
+     * @return The control.
+     */
+    static const Cancellation& none() {
+        static const Cancellation never;
+        return never;
+    }
+};
+
+
+#endif //RAILNETWORK_CANCELLATION_H
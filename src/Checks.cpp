@@ -0,0 +1,120 @@
+#include <climits>
+#include <iostream>
+#include <list>
+#include <random>
+#include <vector>
+
+#include "Checks.h"
+#include "RailManager.h"
+
+using namespace std;
+
+unsigned Checks::edits(const string &datasetPath, unsigned edits, unsigned seed) {
+    const unsigned editsPerRound = 30, pairsPerRound = 100;
+    unsigned differences = 0;
+    for (CapacityPolicy policy : {PER_DIRECTION, SHARED}) {
+        RailManager edited(datasetPath);
+        edited.setCapacityPolicy(policy);
+        edited.build();
+        mt19937 rng(seed);
+        vector<string> names;
+        for (const auto& [name, _] : *edited.stations) names.push_back(name);
+        auto pick = [&names, &rng]() { return names[rng() % names.size()]; };
+        auto neighbours = [&edited](const string& station) {
+            vector<pair<string, unsigned>> res;
+            auto it = edited.incident->find(station);
+            if (it == edited.incident->end()) return res;
+            for (unsigned id : it->second) {
+                const Segment& segment = (*edited.segments)[id];
+                res.emplace_back(segment.origin == station ? segment.destination : segment.origin, segment.capacity);
+            }
+            return res;
+        };
+        unsigned applied = 0, compared = 0, flowing = 0, added = 0, failed = 0;
+        while (applied < edits && !names.empty()) {
+            for (unsigned e = 0; e < editsPerRound && applied < edits && !names.empty(); e++, applied++) {
+                const string station = pick();
+                vector<pair<string, unsigned>> adjacent = neighbours(station);
+                switch (rng() % 6) {
+                    case 0:
+                        edited.insertSegment(station, pick(), 1 + rng() % 8, rng() % 2 ? STANDARD : ALFA_PENDULAR);
+                        break;
+                    case 1:
+                        if (!adjacent.empty()) edited.removeSegment(station, adjacent[rng() % adjacent.size()].first);
+                        break;
+                    case 2:
+                        if (!adjacent.empty()) edited.setSegmentCapacity(station, adjacent[0].first, 1 + rng() % 10);
+                        break;
+                    case 3: {
+                        string name = "Check " + to_string(added++);
+                        edited.insertStation(name, "D", "M", "T", "L");
+                        names.push_back(name);
+                        edited.insertSegment(name, station, 3, STANDARD);
+                        break;
+                    }
+                    case 4: {
+                        size_t i = rng() % names.size();
+                        edited.removeStation(names[i]);
+                        names.erase(names.begin() + (long) i);
+                        break;
+                    }
+                    default:
+                        if (!adjacent.empty()) edited.setSegmentCapacity(station, adjacent[0].first, adjacent[0].second + 1);
+                }
+            }
+            RailManager fresh; // The same stations and segments, with everything built from them on first use
+            fresh.stations = edited.stations;
+            fresh.segments = edited.segments;
+            fresh.incident = edited.incident;
+            fresh.setCapacityPolicy(policy);
+            if (fresh.segments->empty()) {
+                cout << "No segments left after " << applied << " edits, nothing to compare." << endl;
+                failed++;
+                break;
+            }
+            for (unsigned q = 0; q < pairsPerRound && names.size() > 1; q++) {
+                const string origin = pick(), destination = pick();
+                if (origin == destination) continue;
+                const Scenario scenario({}, {pick()});
+                compared++;
+                const unsigned flow = fresh.maxFlow(origin, destination);
+                flowing += flow > 0;
+                if (edited.maxFlow(origin, destination) != flow ||
+                    edited.maxFlowReduced(origin, destination, scenario) != fresh.maxFlowReduced(origin, destination, scenario) ||
+                    edited.componentsNetwork().components->connected(origin, destination) != fresh.componentsNetwork().components->connected(origin, destination)) {
+                    if (failed++ < 5) cout << "Differs after " << applied << " edits: " << origin << " -> " << destination << endl;
+                }
+            }
+        }
+        cout << (policy == SHARED ? "Shared" : "Per direction") << " capacity: " << applied << " edits, " << compared
+             << " pairs compared to a fresh build (" << flowing << " with flow), " << failed << " differ." << endl;
+        if (flowing == 0) cout << "No compared pair has any flow, so the flows were not compared." << endl;
+        differences += failed + (flowing == 0);
+    }
+    return differences;
+}
+
+unsigned Checks::workers(const string &datasetPath, unsigned workers) {
+    RailManager railMan(datasetPath);
+    if (railMan.segments->empty()) {
+        cout << "No segments loaded from " << datasetPath << ", nothing to compare." << endl;
+        return 1;
+    }
+    RailNetwork& network = railMan.componentsNetwork();
+    unsigned differences = 0;
+    const pair<StationAttribute, const char*> attributes[] = {{DISTRICT, "districts"}, {MUNICIPALITY, "municipalities"}, {TOWNSHIP, "townships"}, {LINE, "lines"}};
+    for (const auto& [attribute, name] : attributes) {
+        list<pair<string, unsigned>> one = network.topGroups(INT_MAX, *railMan.stationIndex, attribute, Cancellation::none(), 1);
+        list<pair<string, unsigned>> many = network.topGroups(INT_MAX, *railMan.stationIndex, attribute, Cancellation::none(), workers);
+        const bool same = one == many;
+        cout << "Ranking " << one.size() << " " << name << " on 1 and " << workers << " workers: " << (same ? "same" : "differs") << "." << endl;
+        differences += !same;
+    }
+    list<pair<string, string>> onePairs, manyPairs;
+    unsigned oneFlow = network.allPairsMaxFlow(&onePairs, Cancellation::none(), false, 1);
+    unsigned manyFlow = network.allPairsMaxFlow(&manyPairs, Cancellation::none(), false, workers);
+    const bool same = oneFlow == manyFlow && onePairs == manyPairs;
+    cout << "Pairs with the largest flow (" << oneFlow << ", " << onePairs.size() << " pairs) on 1 and " << workers << " workers: " << (same ? "same" : "differs") << "." << endl;
+    if (oneFlow == 0) cout << "No flow between any pair, so the searches were not compared." << endl;
+    return differences + !same + (oneFlow == 0);
+}
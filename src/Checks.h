@@ -0,0 +1,38 @@
+#ifndef RAILNETWORK_CHECKS_H
+#define RAILNETWORK_CHECKS_H
+
+#include <string>
+
+/**
+ * @brief Self-checks of the loaded dataset, run from the command line, for invariants no single query shows: that the
+ * structures kept up to date by edits answer like ones built from scratch, and that parallel searches answer the same
+ * on any number of workers.
+ * Each check prints what it compared and returns the number of differences found, so 0 means it passed.
+ */
+class Checks {
+public:
+    /**
+     * @brief Applies random edits (adding, removing and re-capacitating segments, adding and removing stations) to a
+     * dataset whose graph, indexes and contraction are built, so every edit updates them incrementally. Every few
+     * edits, the flows, reduced flows and connectivity of random pairs are compared to those of the same stations and
+     * segments built from scratch. Runs under both capacity policies.
+     * @param datasetPath The path to the directory containing the CSV files.
+     * @param edits The number of edits under each policy.
+     * @param seed The seed of the random edits and pairs.
+     * @return The number of answers that differ, plus 1 under each policy where the fresh build has no segments or no
+     * compared pair has any flow.
+     */
+    static unsigned edits(const std::string& datasetPath, unsigned edits = 300, unsigned seed = 42);
+    /**
+     * @brief Ranks the groups of every station attribute, and finds the pairs of stations with the largest flow, on one
+     * worker and on many, and compares the answers, which must be the same (the searches skip work depending on how
+     * the workers interleave, but never anything that changes the answer).
+     * @param datasetPath The path to the directory containing the CSV files.
+     * @param workers The number of workers to compare one worker to (more than the cores, to interleave them more).
+     * @return The number of answers that differ, or 1 if there are no segments or no flow between any pair.
+     */
+    static unsigned workers(const std::string& datasetPath, unsigned workers = 8);
+};
+
+
+#endif //RAILNETWORK_CHECKS_H
@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <climits>
+#include <unordered_set>
+
+#include "ComponentIndex.h"
+#include "RailNetwork.h"
+
+using namespace std;
+
+
+unsigned long long ComponentIndex::segmentKey(unsigned origin, unsigned destination) {
+    return ((unsigned long long) origin << 32) | destination;
+}
+
+ComponentIndex::ComponentIndex(const RailNetwork &network) {
+    unordered_map<string, unsigned> names;
+    for (const auto& [name, node] : network.nodes)
+        names.emplace(name, names.size());
+    vector<vector<unsigned>> graph(names.size());
+    for (const auto& [name, node] : network.nodes) {
+        unsigned id = names.at(name);
+        for (const auto& edge : node.adj) {
+            auto it = names.find(*edge.dest);
+            if (it == names.end() || it->second == id) continue;
+            graph[id].push_back(it->second);
+            graph[it->second].push_back(id);
+        }
+    }
+    for (auto& adjacent : graph) {
+        sort(adjacent.begin(), adjacent.end());
+        adjacent.erase(unique(adjacent.begin(), adjacent.end()), adjacent.end());
+    }
+    ids = make_shared<unordered_map<string, unsigned>>(std::move(names));
+    neighbours = make_shared<vector<vector<unsigned>>>(std::move(graph));
+    labels = make_shared<Labels>();
+    labels->component.assign(neighbours->size(), UINT_MAX);
+    for (unsigned station = 0; station < labels->component.size(); station++)
+        if (labels->component[station] == UINT_MAX) {
+            labels->members.emplace_back();
+            flood(station, (unsigned) labels->members.size() - 1);
+        }
+}
+
+unsigned ComponentIndex::label(unsigned station) const {
+    if (!relabelled.empty()) {
+        auto it = relabelled.find(station);
+        if (it != relabelled.end()) return it->second;
+    }
+    return labels->component[station];
+}
+
+void ComponentIndex::flood(unsigned station, unsigned label) {
+    Labels& own = *labels; // Already owned by the caller
+    own.component[station] = label;
+    own.members[label].push_back(station);
+    vector<unsigned> stack{station};
+    while (!stack.empty()) {
+        unsigned curr = stack.back();
+        stack.pop_back();
+        for (unsigned next : (*neighbours)[curr]) {
+            if (own.component[next] == label) continue;
+            own.component[next] = label;
+            own.members[label].push_back(next);
+            stack.push_back(next);
+        }
+    }
+}
+
+void ComponentIndex::relabel(const unordered_set<unsigned> &touched) {
+    Labels& own = ownLabels();
+    vector<unsigned> stations, free(touched.begin(), touched.end()); // Labels to give the pieces first
+    for (unsigned label : touched) {
+        for (unsigned station : own.members[label]) {
+            own.component[station] = UINT_MAX;
+            stations.push_back(station);
+        }
+        own.members[label].clear();
+    }
+    for (unsigned station : stations) {
+        if (own.component[station] != UINT_MAX) continue;
+        unsigned label;
+        if (!free.empty()) {
+            label = free.back();
+            free.pop_back();
+        } else {
+            label = (unsigned) own.members.size();
+            own.members.emplace_back();
+        }
+        flood(station, label);
+    }
+}
+
+void ComponentIndex::relabelScenario(const unordered_set<unsigned> &touched) {
+    vector<unsigned> stations;
+    for (unsigned label : touched)
+        for (unsigned station : labels->members[label]) {
+            relabelled[station] = UINT_MAX;
+            stations.push_back(station);
+        }
+    for (unsigned station : stations) { // The neighbours of each are in the same touched component
+        if (relabelled.at(station) != UINT_MAX) continue;
+        const unsigned label = (unsigned) labels->members.size() + components++;
+        relabelled[station] = label;
+        if (removed.count(station)) continue;
+        vector<unsigned> stack{station};
+        while (!stack.empty()) {
+            unsigned curr = stack.back();
+            stack.pop_back();
+            for (unsigned next : (*neighbours)[curr]) {
+                unsigned& nextLabel = relabelled.at(next);
+                if (nextLabel != UINT_MAX || removed.count(next)) continue;
+                if (!disabled.empty() && disabled.count(segmentKey(curr, next)) && disabled.count(segmentKey(next, curr))) continue;
+                nextLabel = label;
+                stack.push_back(next);
+            }
+        }
+    }
+}
+
+vector<vector<unsigned>>& ComponentIndex::ownGraph() {
+    if (neighbours.use_count() > 1) neighbours = make_shared<vector<vector<unsigned>>>(*neighbours);
+    return *neighbours;
+}
+
+ComponentIndex::Labels& ComponentIndex::ownLabels() {
+    if (labels.use_count() > 1) labels = make_shared<Labels>(*labels);
+    return *labels;
+}
+
+unsigned ComponentIndex::ownId(const string &station) {
+    auto it = ids->find(station);
+    if (it != ids->end()) return it->second;
+    if (ids.use_count() > 1) ids = make_shared<unordered_map<string, unsigned>>(*ids);
+    unsigned id = (unsigned) labels->component.size();
+    ids->emplace(station, id);
+    ownGraph().emplace_back();
+    Labels& own = ownLabels();
+    own.component.push_back((unsigned) own.members.size());
+    own.members.push_back({id});
+    return id;
+}
+
+bool ComponentIndex::empty() const {
+    return ids == nullptr;
+}
+
+bool ComponentIndex::connected(const string &origin, const string &destination) const {
+    if (empty()) return true;
+    auto o = ids->find(origin), d = ids->find(destination);
+    if (o == ids->end() || d == ids->end()) return true;
+    return label(o->second) == label(d->second) && !removed.count(d->second);
+}
+
+bool ComponentIndex::connected(const list<string> &origins, const string &destination) const {
+    if (empty()) return true;
+    auto d = ids->find(destination);
+    if (d == ids->end()) return true;
+    if (removed.count(d->second)) return false;
+    for (const string& origin : origins) {
+        auto o = ids->find(origin);
+        if (o == ids->end() || (!removed.count(o->second) && label(o->second) == label(d->second))) return true;
+    }
+    return false;
+}
+
+unsigned ComponentIndex::componentOf(const string &station) const {
+    if (empty()) return UINT_MAX;
+    auto it = ids->find(station);
+    return it == ids->end() ? UINT_MAX : label(it->second);
+}
+
+ComponentIndex ComponentIndex::without(const Scenario &scenario) const {
+    ComponentIndex res = *this; // Shares the graph and the labels
+    if (empty()) return res;
+    unordered_set<unsigned> touched; // Shared labels, whose components are labelled again with all the changes
+    for (const string& station : scenario.stations) {
+        auto it = ids->find(station);
+        if (it == ids->end() || !res.removed.insert(it->second).second) continue;
+        touched.insert(labels->component[it->second]);
+    }
+    for (const auto& [origin, destinations] : scenario.segments) {
+        auto o = ids->find(origin);
+        if (o == ids->end()) continue;
+        for (const string& destination : destinations) {
+            auto d = ids->find(destination);
+            if (d == ids->end()) continue;
+            res.disabled.insert(segmentKey(o->second, d->second));
+            if (res.disabled.count(segmentKey(d->second, o->second))) touched.insert(labels->component[o->second]);
+        }
+    }
+    if (!touched.empty()) res.relabelScenario(touched);
+    return res;
+}
+
+// []===========================================[] //
+// ||                   EDITS                   || //
+// []===========================================[] //
+
+void ComponentIndex::addStation(const string &station) {
+    if (!empty()) ownId(station);
+}
+
+void ComponentIndex::removeStation(const string &station) {
+    if (empty() || !ids->count(station)) return;
+    unsigned id = ids->at(station);
+    vector<vector<unsigned>>& graph = ownGraph();
+    for (unsigned next : graph[id]) {
+        vector<unsigned>& adjacent = graph[next];
+        adjacent.erase(find(adjacent.begin(), adjacent.end(), id));
+    }
+    graph[id].clear();
+    relabel({labels->component[id]});
+}
+
+void ComponentIndex::addSegment(const string &stationA, const string &stationB) {
+    if (empty()) return;
+    unsigned a = ownId(stationA), b = ownId(stationB);
+    vector<vector<unsigned>>& graph = ownGraph();
+    if (a == b || find(graph[a].begin(), graph[a].end(), b) != graph[a].end()) return;
+    graph[a].push_back(b);
+    graph[b].push_back(a);
+    Labels& own = ownLabels();
+    unsigned big = own.component[a], small = own.component[b];
+    if (big == small) return;
+    if (own.members[big].size() < own.members[small].size()) swap(big, small);
+    for (unsigned station : own.members[small]) // The larger component takes over the smaller
+        own.component[station] = big;
+    own.members[big].insert(own.members[big].end(), own.members[small].begin(), own.members[small].end());
+    own.members[small].clear();
+}
+
+void ComponentIndex::removeSegment(const string &stationA, const string &stationB) {
+    if (empty() || !ids->count(stationA) || !ids->count(stationB)) return;
+    unsigned a = ids->at(stationA), b = ids->at(stationB);
+    auto it = find((*neighbours)[a].begin(), (*neighbours)[a].end(), b);
+    if (it == (*neighbours)[a].end()) return;
+    vector<vector<unsigned>>& graph = ownGraph();
+    graph[a].erase(find(graph[a].begin(), graph[a].end(), b));
+    graph[b].erase(find(graph[b].begin(), graph[b].end(), a));
+    relabel({labels->component[a]});
+}
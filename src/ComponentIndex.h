@@ -0,0 +1,158 @@
+#ifndef RAILNETWORK_COMPONENTINDEX_H
+#define RAILNETWORK_COMPONENTINDEX_H
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Scenario.h"
+
+class RailNetwork;
+
+/**
+ * @brief The connected components of a rail network, to answer "can any train get from here to there?" in O(1).
+ * Segments are taken as undirected, so stations in different components can't reach each other at all (the converse
+ * isn't guaranteed, but the datasets have every segment both ways). Every component keeps the list of its stations,
+ * so only the stations of the components a change touches are labelled again. A scenario shares the graph and the
+ * labels with the original index, and only keeps what it changes over them. Edits to the network change the labels
+ * themselves, and the graph and labels are only copied if another index still shares them.
+ */
+class ComponentIndex {
+    /**
+     * @brief The label of each station, and the stations of each label.
+     */
+    struct Labels {
+        std::vector<unsigned> component;
+        std::vector<std::vector<unsigned>> members; // Empty for labels no station has anymore
+    };
+    std::shared_ptr<std::unordered_map<std::string, unsigned>> ids;
+    std::shared_ptr<std::vector<std::vector<unsigned>>> neighbours;
+    std::shared_ptr<Labels> labels;
+    // What a scenario changes over the labels: the new labels of the stations of the components it touches, the
+    // stations and segments (by direction) out of service, and how many labels it added after the shared ones
+    std::unordered_map<unsigned, unsigned> relabelled;
+    std::unordered_set<unsigned> removed;
+    std::unordered_set<unsigned long long> disabled;
+    unsigned components = 0;
+    /**
+     * @brief Returns the key of the segment from one station to another.
+     * @param origin The id of the origin station.
+     * @param destination The id of the destination station.
+     * @return The key.
+     */
+    static unsigned long long segmentKey(unsigned origin, unsigned destination);
+    /**
+     * @brief Returns the label of a station, as changed by the scenario if it touched its component.
+     * @param station The id of the station.
+     * @return The label.
+     */
+    unsigned label(unsigned station) const;
+    /**
+     * @brief Labels every station connected to the given one, which has no label yet.
+     * @param station The id of the station.
+     * @param label The label of its component.
+     */
+    void flood(unsigned station, unsigned label);
+    /**
+     * @brief Labels the stations of some components again, leaving the other components as they are. The first piece
+     * of a component keeps its label.
+     * @param touched The labels of the components.
+     */
+    void relabel(const std::unordered_set<unsigned>& touched);
+    /**
+     * @brief Labels the stations of some components again for a scenario, without going through removed stations or
+     * segments out of service in both directions, over the labels shared with the original index.
+     * @param touched The shared labels of the components.
+     */
+    void relabelScenario(const std::unordered_set<unsigned>& touched);
+    /**
+     * @brief Returns the graph to be edited, copying it first if another index shares it.
+     * @return The neighbours of each station.
+     */
+    std::vector<std::vector<unsigned>>& ownGraph();
+    /**
+     * @brief Returns the labels to be edited, copying them first if another index shares them.
+     * @return The labels.
+     */
+    Labels& ownLabels();
+    /**
+     * @brief Returns the id of a station, adding it in a component of its own if the index doesn't know it.
+     * @param station The name of the station.
+     * @return The id.
+     */
+    unsigned ownId(const std::string& station);
+public:
+    /**
+     * @brief Default constructor. Creates an empty index, which assumes every two stations are connected.
+     */
+    ComponentIndex() = default;
+    /**
+     * @brief Labels the components of a network.
+     * @param network The network.
+     */
+    explicit ComponentIndex(const RailNetwork& network);
+    /**
+     * @brief Checks if the index was built.
+     * @return True if the index is empty.
+     */
+    bool empty() const;
+    /**
+     * @brief Checks if two stations may be connected. Stations the index doesn't know always may.
+     * @param origin The name of the origin station.
+     * @param destination The name of the destination station.
+     * @return False if there is surely no way between them.
+     */
+    bool connected(const std::string& origin, const std::string& destination) const;
+    /**
+     * @brief Checks if any of some stations may be connected to another.
+     * @param origins The names of the origin stations.
+     * @param destination The name of the destination station.
+     * @return False if there is surely no way from any origin to the destination.
+     */
+    bool connected(const std::list<std::string>& origins, const std::string& destination) const;
+    /**
+     * @brief Returns the label of the component of a station. Two stations are connected iff their labels are equal.
+     * @param station The name of the station.
+     * @return The label, or UINT_MAX if the index doesn't know the station.
+     */
+    unsigned componentOf(const std::string& station) const;
+    /**
+     * @brief Returns the index of the network with the stations and segments of a scenario also out of service.
+     * Stations out of service are connected to nothing (a super source linked to them can't use them), and a segment
+     * only splits a component when it is out of service in both directions. Takes the time of the components the
+     * scenario touches, not of the whole network. The edits below are only made to indexes without a scenario.
+     * @param scenario The stations and segments out of service.
+     * @return The new index, which shares the graph and the labels with this one.
+     */
+    ComponentIndex without(const Scenario& scenario) const;
+    /**
+     * @brief Adds a station to the network, in a component of its own. Does nothing on an empty index.
+     * @param station The name of the station.
+     */
+    void addStation(const std::string& station);
+    /**
+     * @brief Removes a station and its segments from the network, splitting its component if it held it together.
+     * Does nothing on an empty index.
+     * @param station The name of the station.
+     */
+    void removeStation(const std::string& station);
+    /**
+     * @brief Adds a segment to the network, merging the components of its stations. Does nothing on an empty index.
+     * @param stationA The name of a station.
+     * @param stationB The name of the other station.
+     */
+    void addSegment(const std::string& stationA, const std::string& stationB);
+    /**
+     * @brief Removes a segment (both ways) from the network, splitting its component if it was a bridge. Does nothing
+     * on an empty index.
+     * @param stationA The name of a station.
+     * @param stationB The name of the other station.
+     */
+    void removeSegment(const std::string& stationA, const std::string& stationB);
+};
+
+
+#endif //RAILNETWORK_COMPONENTINDEX_H
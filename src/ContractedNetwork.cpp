@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "ContractedNetwork.h"
+
+using namespace std;
+
+
+ContractedNetwork::ContractedNetwork(const RailNetwork &network) {
+    graph.capacityPolicy = network.capacityPolicy; // Each chain and its way back share the capacity of the same segments
+    unordered_map<string, set<string>> neighbours;
+    for (const auto& [name, node] : network.nodes) {
+        neighbours[name];
+        for (const auto& edge : node.adj) {
+            if (*edge.dest == name) continue;
+            neighbours[name].insert(*edge.dest);
+            neighbours[*edge.dest].insert(name);
+        }
+    }
+    set<string> junctions;
+    for (const auto& [name, adj] : neighbours)
+        if (adj.size() != 2) junctions.insert(name);
+
+    // Walk every chain from its junctions, until no two chains join the same junctions
+    list<vector<string>> paths;
+    while (true) {
+        paths.clear();
+        unordered_set<string> walked;
+        map<pair<string, string>, unsigned> ends;
+        for (const string& junction : junctions) {
+            for (const string& next : neighbours.at(junction)) {
+                if (walked.count(next)) continue; // Walked from its other end
+                if (junctions.count(next) && next < junction) continue; // Plain segment, walked from its other end
+                vector<string> path{junction};
+                string prev = junction, curr = next;
+                while (!junctions.count(curr)) {
+                    walked.insert(curr);
+                    path.push_back(curr);
+                    const set<string>& adj = neighbours.at(curr);
+                    string following = *adj.begin() == prev ? *adj.rbegin() : *adj.begin();
+                    prev = curr;
+                    curr = following;
+                }
+                path.push_back(curr);
+                ends[minmax(path.front(), path.back())]++;
+                paths.push_back(std::move(path));
+            }
+        }
+        size_t before = junctions.size();
+        for (const vector<string>& path : paths)
+            if (path.size() > 2 && (path.front() == path.back() || ends.at(minmax(path.front(), path.back())) > 1))
+                junctions.insert(path[path.size() / 2]);
+        for (const auto& [name, adj] : neighbours)
+            if (!junctions.count(name) && !walked.count(name)) { // A cycle without junctions
+                junctions.insert(name);
+                break;
+            }
+        if (junctions.size() == before) break;
+    }
+
+    for (const string& junction : junctions)
+        graph.addNode(junction, {});
+    for (vector<string>& path : paths) {
+        for (int direction = 0; direction < 2; direction++) {
+            Chain chain{path, {}, {}};
+            for (size_t i = 0; i + 1 < path.size(); i++) {
+                chain.capacities.push_back(0);
+                chain.types.push_back(INVALID);
+                for (const auto& edge : network.nodes.at(path[i]).adj)
+                    if (*edge.dest == path[i + 1]) {
+                        chain.capacities.back() = edge.capacity;
+                        chain.types.back() = edge.type;
+                        break;
+                    }
+            }
+            addChain(std::move(chain));
+            reverse(path.begin(), path.end());
+        }
+    }
+}
+
+void ContractedNetwork::addChain(Chain chain) {
+    const string origin = chain.stations.front();
+    const string destination = chain.stations.back();
+    SegmentType type = chain.types.front();
+    bool crossable = type != INVALID;
+    for (SegmentType t : chain.types)
+        if (t != type) crossable = false;
+    if (crossable)
+        graph.addEdge(origin, RailNetwork::Edge(graph.intern(destination), type, *min_element(chain.capacities.begin(), chain.capacities.end())));
+    for (size_t i = 1; i + 1 < chain.stations.size(); i++)
+        interior[chain.stations[i]] = {origin, destination};
+    chains[origin].insert_or_assign(destination, std::move(chain));
+}
+
+ContractedNetwork::Split ContractedNetwork::split(const string &station) {
+    const auto [a, b] = interior.at(station);
+    interior.erase(station);
+    graph.addNode(station, {});
+    Split res{station, std::move(chains.at(a).at(b)), std::move(chains.at(b).at(a))};
+    for (const Chain* chain : {&res.forward, &res.backward}) {
+        const string& origin = chain->stations.front();
+        const string& destination = chain->stations.back();
+        chains.at(origin).erase(destination);
+        graph.removeEdge(origin, destination);
+        long i = find(chain->stations.begin(), chain->stations.end(), station) - chain->stations.begin();
+        addChain({{chain->stations.begin(), chain->stations.begin() + i + 1},
+                  {chain->capacities.begin(), chain->capacities.begin() + i},
+                  {chain->types.begin(), chain->types.begin() + i}});
+        addChain({{chain->stations.begin() + i, chain->stations.end()},
+                  {chain->capacities.begin() + i, chain->capacities.end()},
+                  {chain->types.begin() + i, chain->types.end()}});
+    }
+    return res;
+}
+
+void ContractedNetwork::join(Split split) {
+    for (const Chain* chain : {&split.forward, &split.backward}) {
+        const string& origin = chain->stations.front();
+        chains.at(origin).erase(split.station);
+        graph.removeEdge(origin, split.station);
+    }
+    chains.erase(split.station);
+    graph.nodes.erase(split.station);
+    addChain(std::move(split.forward));
+    addChain(std::move(split.backward));
+}
+
+void ContractedNetwork::makeJunction(const string &station) {
+    if (interior.count(station)) split(station);
+}
+
+template<class F>
+auto ContractedNetwork::splitFor(const list<string> &stations, F query) {
+    list<Split> splits;
+    for (const string& station : stations)
+        if (interior.count(station)) splits.push_front(split(station));
+    try {
+        auto res = query();
+        for (Split& s : splits) join(std::move(s));
+        return res;
+    } catch (...) {
+        for (Split& s : splits) join(std::move(s));
+        throw;
+    }
+}
+
+MinCut ContractedNetwork::lastMinCut() {
+    MinCut contracted = graph.lastMinCut();
+    MinCut cut;
+    cut.sourceSide = contracted.sourceSide;
+    for (const Segment& segment : contracted.segments) {
+        const Chain& chain = chains.at(segment.origin).at(segment.destination);
+        size_t i = find(chain.capacities.begin(), chain.capacities.end(), segment.capacity) - chain.capacities.begin();
+        cut.segments.emplace_back(chain.stations[i], chain.stations[i + 1], chain.capacities[i], chain.types[i]);
+    }
+    // Trains entering a chain reach its stations up to its first saturated segment, or until it changes service
+    unordered_set<string> sourceSide(contracted.sourceSide.begin(), contracted.sourceSide.end());
+    for (const string& station : contracted.sourceSide) {
+        auto it = chains.find(station);
+        if (it == chains.end()) continue;
+        RailNetwork::Node& node = graph.getNode(station);
+        for (const auto& [destination, chain] : it->second) {
+            unsigned flow = 0;
+            for (const RailNetwork::Edge& edge : node.adj)
+                if (*edge.dest == destination) flow = graph.getFlow(edge);
+            for (size_t i = 0; i + 2 < chain.stations.size(); i++) {
+                if (chain.types[i] != chain.types.front() || chain.types[i] == INVALID) break;
+                if (flow > 0 && chain.capacities[i] == flow) break;
+                if (sourceSide.insert(chain.stations[i + 1]).second) cut.sourceSide.push_back(chain.stations[i + 1]);
+            }
+        }
+    }
+    return cut;
+}
+
+size_t ContractedNetwork::size() const {
+    return graph.nodes.size();
+}
+
+// []===========================================[] //
+// ||                  QUERIES                  || //
+// []===========================================[] //
+
+unsigned ContractedNetwork::maxFlow(const string &origin, const string &destination) {
+    return splitFor({origin, destination}, [&]() {
+        return graph.maxFlow(origin, destination);
+    });
+}
+
+pair<unsigned, MinCut> ContractedNetwork::maxFlowCut(const string &origin, const string &destination) {
+    return splitFor({origin, destination}, [&]() {
+        unsigned flow = graph.maxFlow(origin, destination);
+        return make_pair(flow, lastMinCut());
+    });
+}
+
+unsigned ContractedNetwork::maxFlowReduced(const string &origin, const string &destination, const Scenario &scenario) {
+    list<string> stations = scenario.namedStations();
+    stations.push_back(origin);
+    stations.push_back(destination);
+    return splitFor(stations, [&]() {
+        return graph.maxFlowReduced(origin, destination, scenario);
+    });
+}
+
+pair<unsigned, MinCut> ContractedNetwork::maxFlowReducedCut(const string &origin, const string &destination, const Scenario &scenario) {
+    list<string> stations = scenario.namedStations();
+    stations.push_back(origin);
+    stations.push_back(destination);
+    return splitFor(stations, [&]() {
+        unsigned flow = graph.maxFlowReduced(origin, destination, scenario);
+        return make_pair(flow, lastMinCut());
+    });
+}
+
+// []===========================================[] //
+// ||                   EDITS                   || //
+// []===========================================[] //
+
+void ContractedNetwork::addStation(const string &station) {
+    graph.addNode(station, {});
+}
+
+void ContractedNetwork::removeStation(const string &station) {
+    makeJunction(station);
+    vector<string> adjacent;
+    if (chains.count(station))
+        for (const auto& [_, chain] : chains.at(station))
+            adjacent.push_back(chain.stations[1]);
+    for (const string& next : adjacent) // Then every chain from the station is a single segment
+        makeJunction(next);
+    if (chains.count(station)) {
+        for (const auto& [destination, _] : chains.at(station))
+            chains.at(destination).erase(station);
+        chains.erase(station);
+    }
+    graph.removeNode(station);
+}
+
+void ContractedNetwork::addSegment(const string &stationA, const string &stationB, unsigned capacity, SegmentType service) {
+    makeJunction(stationA);
+    makeJunction(stationB);
+    auto it = chains.find(stationA);
+    if (it != chains.end() && it->second.count(stationB)) { // Another chain joins them, split at its middle station
+        const vector<string>& stations = it->second.at(stationB).stations;
+        const string middle = stations[stations.size() / 2];
+        makeJunction(middle);
+    }
+    addChain({{stationA, stationB}, {capacity}, {service}});
+    addChain({{stationB, stationA}, {capacity}, {service}});
+}
+
+void ContractedNetwork::removeSegment(const string &stationA, const string &stationB) {
+    makeJunction(stationA);
+    makeJunction(stationB);
+    for (const auto& [origin, destination] : {make_pair(stationA, stationB), make_pair(stationB, stationA)}) {
+        chains.at(origin).erase(destination);
+        graph.removeEdge(origin, destination);
+    }
+}
+
+void ContractedNetwork::setCapacity(const string &origin, const string &destination, unsigned capacity) {
+    list<pair<string, string>> candidates; // The ends of the chains that may hold the segment
+    auto it = interior.find(origin);
+    if (it != interior.end()) candidates = {it->second, {it->second.second, it->second.first}};
+    else if (chains.count(origin))
+        for (const auto& [end, _] : chains.at(origin))
+            candidates.emplace_back(origin, end);
+    for (const auto& [start, end] : candidates) {
+        Chain& chain = chains.at(start).at(end);
+        for (size_t i = 0; i + 1 < chain.stations.size(); i++) {
+            if (chain.stations[i] != origin || chain.stations[i + 1] != destination) continue;
+            chain.capacities[i] = capacity;
+            for (RailNetwork::Edge& edge : graph.getNode(start).adj)
+                if (*edge.dest == end) edge.capacity = *min_element(chain.capacities.begin(), chain.capacities.end());
+            return;
+        }
+    }
+}
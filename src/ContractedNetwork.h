@@ -0,0 +1,162 @@
+#ifndef RAILNETWORK_CONTRACTEDNETWORK_H
+#define RAILNETWORK_CONTRACTEDNETWORK_H
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "MinCut.h"
+#include "RailNetwork.h"
+#include "Scenario.h"
+#include "Segment.h"
+
+/**
+ * @brief A rail network with its lines contracted, used to answer flow queries on a much smaller graph.
+ * Most stations only connect to two others. Between two junctions (stations with any other number of neighbours) such
+ * stations form a chain, and trains can only cross a chain end to end, with a single service type, at most as many as
+ * its smallest segment allows. Each chain direction is replaced by one edge with that capacity (chains that mix
+ * service types can't be crossed, so they get none). Queries on stations inside a chain split it at those stations,
+ * and cuts are mapped back to the original segments. Edits to the network split the chains through the stations they
+ * name for good, so they only touch those chains (the contraction just gets a little finer).
+ */
+class ContractedNetwork {
+    /**
+     * @brief The segments of the original network behind one edge of the contracted one.
+     */
+    struct Chain {
+        std::vector<std::string> stations;
+        std::vector<unsigned> capacities; // Of the segment leaving each station (0 if there is none)
+        std::vector<SegmentType> types; // Of the segment leaving each station (INVALID if there is none)
+    };
+    /**
+     * @brief A chain split at one of its stations, with both its directions, to join it back after a query.
+     */
+    struct Split {
+        std::string station;
+        Chain forward;
+        Chain backward;
+    };
+    RailNetwork graph;
+    std::unordered_map<std::string, std::unordered_map<std::string, Chain>> chains;
+    std::unordered_map<std::string, std::pair<std::string, std::string>> interior;
+    /**
+     * @brief Adds an edge for a chain to the graph, if it can be crossed.
+     * @param chain The chain.
+     */
+    void addChain(Chain chain);
+    /**
+     * @brief Splits the chains through a station in two, making it a junction.
+     * @param station The name of the station, inside a chain.
+     * @return The chains before the split.
+     */
+    Split split(const std::string& station);
+    /**
+     * @brief Undoes a split, joining the chains back.
+     * @param split The chains before the split.
+     */
+    void join(Split split);
+    /**
+     * @brief Makes a station a junction for good, splitting the chain through it if it's inside one.
+     * @param station The name of the station.
+     */
+    void makeJunction(const std::string& station);
+    /**
+     * @brief Runs a query with the given stations as junctions: the chains through them are split for the query and
+     * joined back afterwards.
+     * @param stations The names of the stations that the query needs as junctions.
+     * @param query The query.
+     * @return The result of the query.
+     */
+    template<class F>
+    auto splitFor(const std::list<std::string>& stations, F query);
+    /**
+     * @brief Maps the cut of the last flow query on the contracted graph back to the original network. A chain in the
+     * cut is cut at its first smallest segment, and the stations before it are on the source side.
+     * @return The source side of the cut and the saturated segments leaving it.
+     */
+    MinCut lastMinCut();
+public:
+    /**
+     * @brief Default constructor. Creates an empty network.
+     */
+    ContractedNetwork() = default;
+    /**
+     * @brief Contracts the chains of a network. Chains that would join the same two junctions as another chain or
+     * segment (or form a loop) are split at their middle station, so there is at most one edge per pair of stations.
+     * @param network The network, whose segments are expected to go both ways.
+     */
+    explicit ContractedNetwork(const RailNetwork& network);
+    /**
+     * @brief Returns the number of stations left after contraction.
+     * @return The number of stations in the contracted graph.
+     */
+    size_t size() const;
+    /**
+     * @brief Calculates the maximum flow between two stations, like RailNetwork::maxFlow.
+     * @param origin The name of the origin station.
+     * @param destination The name of the destination station.
+     * @return The maximum flow between the two stations.
+     */
+    unsigned maxFlow(const std::string& origin, const std::string& destination);
+    /**
+     * @brief Calculates the maximum flow between two stations and the minimum cut that limits it.
+     * @param origin The name of the origin station.
+     * @param destination The name of the destination station.
+     * @return A pair of the maximum flow and its minimum cut, in segments of the original network.
+     */
+    std::pair<unsigned, MinCut> maxFlowCut(const std::string& origin, const std::string& destination);
+    /**
+     * @brief Calculates the maximum flow between two stations under a scenario, like RailNetwork::maxFlowReduced.
+     * The chains are split at every station the scenario names, so it applies to the contracted graph as is.
+     * @param origin The name of the origin station.
+     * @param destination The name of the destination station.
+     * @param scenario The stations and segments out of service.
+     * @return The maximum flow between the two stations.
+     */
+    unsigned maxFlowReduced(const std::string& origin, const std::string& destination, const Scenario& scenario);
+    /**
+     * @brief Calculates the maximum flow between two stations under a scenario and the minimum cut that limits it.
+     * @param origin The name of the origin station.
+     * @param destination The name of the destination station.
+     * @param scenario The stations and segments out of service.
+     * @return A pair of the maximum flow and its minimum cut, in segments of the original network.
+     */
+    std::pair<unsigned, MinCut> maxFlowReducedCut(const std::string& origin, const std::string& destination, const Scenario& scenario);
+    /**
+     * @brief Adds a station without segments.
+     * @param station The name of the station.
+     */
+    void addStation(const std::string& station);
+    /**
+     * @brief Removes a station and its segments.
+     * @param station The name of the station.
+     */
+    void removeStation(const std::string& station);
+    /**
+     * @brief Adds a segment both ways between two stations that aren't adjacent yet.
+     * @param stationA The name of a station.
+     * @param stationB The name of the other station.
+     * @param capacity The capacity of the segment.
+     * @param service The service type of the segment.
+     */
+    void addSegment(const std::string& stationA, const std::string& stationB, unsigned capacity, SegmentType service);
+    /**
+     * @brief Removes the segment between two stations, both ways.
+     * @param stationA The name of a station.
+     * @param stationB The name of the other station.
+     */
+    void removeSegment(const std::string& stationA, const std::string& stationB);
+    /**
+     * @brief Changes the capacity of a segment in one direction. The chain holding it stays as it is.
+     * @param origin The name of the origin station.
+     * @param destination The name of the destination station.
+     * @param capacity The new capacity.
+     */
+    void setCapacity(const std::string& origin, const std::string& destination, unsigned capacity);
+};
+
+
+#endif //RAILNETWORK_CONTRACTEDNETWORK_H
@@ -0,0 +1,47 @@
+#ifndef RAILNETWORK_COPYONWRITE_H
+#define RAILNETWORK_COPYONWRITE_H
+
+#include <memory>
+#include <utility>
+
+/**
+ * @brief A value its copies share, read-only, until one of them is edited: only that copy then gets a value of its own.
+ * Copies can be read from many threads at once, but a copy is only edited by the thread that owns it. A moved-from
+ * copy holds nothing until it is assigned again.
+ * @tparam T The type of the value.
+ */
+template<class T>
+class CopyOnWrite {
+    std::shared_ptr<const T> value; // Always made as a T, so the copy that owns it alone can edit it in place
+public:
+    /**
+     * @brief Default constructor. Creates an empty value.
+     */
+    CopyOnWrite() : value(std::make_shared<T>()) {}
+    /**
+     * @brief Creates a copy holding the given value.
+     * @param value The value.
+     */
+    CopyOnWrite(T value) : value(std::make_shared<T>(std::move(value))) {}
+    const T& operator*() const { return *value; }
+    const T* operator->() const { return value.get(); }
+    /**
+     * @brief Gets the value to edit, first copying it if another copy shares it.
+     * @return The value, owned by this copy alone.
+     */
+    T& edit() {
+        if (value.use_count() > 1) value = std::make_shared<T>(*value);
+        return const_cast<T&>(*value);
+    }
+    /**
+     * @brief Checks if this copy shares its value with another.
+     * @param other The other copy.
+     * @return True if they share it.
+     */
+    bool shares(const CopyOnWrite& other) const {
+        return value == other.value;
+    }
+};
+
+
+#endif //RAILNETWORK_COPYONWRITE_H
@@ -0,0 +1,22 @@
+#ifndef RAILNETWORK_FLOWBOUNDS_H
+#define RAILNETWORK_FLOWBOUNDS_H
+
+/**
+ * @brief The result of an approximate max flow query.
+ * The lower bound is a flow that can actually run between the stations, and the upper bound is the capacity of a cut
+ * separating them, which no flow can exceed. When both are equal, the flow is known to be maximum.
+ */
+struct FlowBounds {
+    unsigned lower;
+    unsigned upper;
+    /**
+     * @brief Checks if the bounds meet, i.e. if the lower bound is the maximum flow.
+     * @return True if the bounds are equal.
+     */
+    bool exact() const {
+        return lower == upper;
+    }
+};
+
+
+#endif //RAILNETWORK_FLOWBOUNDS_H
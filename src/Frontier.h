@@ -0,0 +1,179 @@
+#ifndef RAILNETWORK_FRONTIER_H
+#define RAILNETWORK_FRONTIER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Parallel.h"
+
+/**
+ * @brief Breadth-first reachability over a graph with dense ids, for the searches that only need the set of nodes
+ * reached (not their order nor their parents, which the augmenting paths depend on).
+ * Visited sets and frontiers are bitsets, scanned a word at a time. Each level is expanded top-down (the frontier
+ * follows its arcs) while the frontier is small, and bottom-up (every unvisited node looks for a parent in the frontier,
+ * stopping at the first one) once the arcs leaving the frontier outnumber a fraction of the arcs left to explore.
+ * Levels are expanded one at a time (level-synchronous), so on large graphs each level can be split across cores.
+ */
+class Frontier {
+    static const unsigned alpha = 14; // Bottom-up once the frontier has more than 1/alpha of the unexplored arcs
+    static const unsigned beta = 24; // Top-down again once the frontier has less than 1/beta of the nodes
+    static const size_t parallelNodes = 1 << 16; // Smaller graphs are always searched by one thread
+    static const size_t parallelWork = 1 << 14; // Arcs (top-down) or nodes (bottom-up) a level needs to be split
+    static const size_t chunkWords = 16; // Words of the bitsets taken at a time by a worker
+    size_t n = 0;
+    std::vector<size_t> outStart, inStart;
+    std::vector<unsigned> outTarget, outArc; // Of each outgoing arc: its destination and its id
+    std::vector<unsigned> inSource, inArc; // Of each incoming arc: its origin and its id
+    /**
+     * @brief Returns the index of the lowest set bit of a word.
+     * @param word The word, not 0.
+     * @return The index of the bit.
+     */
+    static unsigned lowestBit(uint64_t word) {
+        static const std::vector<unsigned> table = []() {
+            std::vector<unsigned> t(64);
+            for (unsigned i = 0; i < 64; i++) t[((1ULL << i) * 0x03f79d71b4cb0a89ULL) >> 58] = i;
+            return t;
+        }();
+        return table[((word & (~word + 1)) * 0x03f79d71b4cb0a89ULL) >> 58];
+    }
+public:
+    /**
+     * @brief Default constructor. Creates a graph without nodes.
+     */
+    Frontier() = default;
+    /**
+     * @brief Lays out a graph in compressed sparse rows, both ways.
+     * @param nodes The number of nodes, whose ids go from 0 to nodes - 1.
+     * @param arcs The arcs, from origin to destination. The id of an arc is its position.
+     */
+    Frontier(size_t nodes, const std::vector<std::pair<unsigned, unsigned>>& arcs) :
+        n(nodes), outStart(nodes + 1, 0), inStart(nodes + 1, 0),
+        outTarget(arcs.size()), outArc(arcs.size()), inSource(arcs.size()), inArc(arcs.size()) {
+        for (const auto& [origin, destination] : arcs) {
+            outStart[origin + 1]++;
+            inStart[destination + 1]++;
+        }
+        for (size_t i = 0; i < nodes; i++) {
+            outStart[i + 1] += outStart[i];
+            inStart[i + 1] += inStart[i];
+        }
+        std::vector<size_t> outNext(outStart.begin(), outStart.end() - 1), inNext(inStart.begin(), inStart.end() - 1);
+        for (unsigned arc = 0; arc < arcs.size(); arc++) {
+            const auto& [origin, destination] = arcs[arc];
+            outTarget[outNext[origin]] = destination;
+            outArc[outNext[origin]++] = arc;
+            inSource[inNext[destination]] = origin;
+            inArc[inNext[destination]++] = arc;
+        }
+    }
+    /**
+     * @brief Returns the number of nodes.
+     * @return The number of nodes.
+     */
+    size_t size() const {
+        return n;
+    }
+    /**
+     * @brief Finds every node reachable from the sources through the usable arcs (or that reaches them, backwards).
+     * On graphs of at least parallelNodes nodes, levels with enough work are expanded by all cores: the bitsets are
+     * split in chunks of words taken by the workers, which claim new nodes with an atomic or on their word and count
+     * the next frontier locally.
+     * @tparam F bool(unsigned arc), called from several threads on large graphs
+     * @param sources The ids of the source nodes.
+     * @param usable Whether an arc can be followed, by id.
+     * @param backward Whether to follow the arcs backwards.
+     * @return Whether each node was reached.
+     */
+    template<class F>
+    std::vector<bool> reach(const std::vector<unsigned>& sources, F usable, bool backward = false) const {
+        const std::vector<size_t>& start = backward ? inStart : outStart; // Arcs followed top-down
+        const std::vector<unsigned>& target = backward ? inSource : outTarget;
+        const std::vector<unsigned>& arcId = backward ? inArc : outArc;
+        const std::vector<size_t>& parentStart = backward ? outStart : inStart; // Arcs looked up bottom-up
+        const std::vector<unsigned>& parent = backward ? outTarget : inSource;
+        const std::vector<unsigned>& parentArcId = backward ? outArc : inArc;
+        const size_t words = (n + 63) / 64;
+        auto has = [](const std::vector<uint64_t>& set, unsigned node) { return (set[node / 64] >> (node % 64)) & 1; };
+        auto degree = [&start](unsigned node) { return start[node + 1] - start[node]; };
+        std::vector<uint64_t> visited(words, 0), frontier(words, 0);
+        std::vector<std::atomic<uint64_t>> next(words);
+        size_t frontierSize = 0, frontierArcs = 0, unexploredArcs = target.size();
+        for (unsigned source : sources) {
+            if (has(visited, source)) continue;
+            visited[source / 64] |= 1ULL << (source % 64);
+            frontier[source / 64] |= 1ULL << (source % 64);
+            frontierSize++;
+            frontierArcs += degree(source);
+        }
+        unexploredArcs -= frontierArcs;
+        const unsigned workers = n >= parallelNodes ? Parallel::workerCount((words + chunkWords - 1) / chunkWords) : 1;
+        bool bottomUp = false;
+        while (frontierSize > 0) {
+            if (!bottomUp && frontierArcs * alpha > unexploredArcs) bottomUp = true;
+            else if (bottomUp && frontierSize * beta < n) bottomUp = false;
+            for (auto& word : next) word.store(0, std::memory_order_relaxed);
+            std::atomic<size_t> nextChunk(0), nextSize(0), nextArcs(0);
+            auto expand = [&](bool shared) { // Shared if other workers claim nodes at the same time
+                size_t size = 0, arcs = 0;
+                for (size_t chunk = nextChunk++; chunk * chunkWords < words; chunk = nextChunk++)
+                    for (size_t w = chunk * chunkWords; w < std::min(words, (chunk + 1) * chunkWords); w++) {
+                        uint64_t word = bottomUp ? ~visited[w] : frontier[w];
+                        if (bottomUp && w == words - 1 && n % 64 != 0) word &= (1ULL << (n % 64)) - 1;
+                        uint64_t found = 0; // Bottom-up, only this worker writes this word
+                        for (; word != 0; word &= word - 1) {
+                            unsigned node = (unsigned) (w * 64 + lowestBit(word));
+                            if (bottomUp) { // Look for a parent
+                                for (size_t i = parentStart[node]; i < parentStart[node + 1]; i++)
+                                    if (has(frontier, parent[i]) && usable(parentArcId[i])) {
+                                        found |= 1ULL << (node % 64);
+                                        size++;
+                                        arcs += degree(node);
+                                        break;
+                                    }
+                                continue;
+                            }
+                            for (size_t i = start[node]; i < start[node + 1]; i++) {
+                                unsigned child = target[i];
+                                if (has(visited, child) || !usable(arcId[i])) continue;
+                                std::atomic<uint64_t>& claim = next[child / 64];
+                                const uint64_t bit = 1ULL << (child % 64);
+                                uint64_t before = claim.load(std::memory_order_relaxed);
+                                if (before & bit) continue;
+                                if (shared) before = claim.fetch_or(bit, std::memory_order_relaxed);
+                                else claim.store(before | bit, std::memory_order_relaxed);
+                                if (before & bit) continue; // Claimed by another worker
+                                size++;
+                                arcs += degree(child);
+                            }
+                        }
+                        if (bottomUp) next[w].store(found, std::memory_order_relaxed);
+                    }
+                nextSize += size;
+                nextArcs += arcs;
+            };
+            if (workers > 1 && (bottomUp ? n : frontierArcs) >= parallelWork)
+                Parallel::forEachWorker(workers, [&expand](unsigned) { expand(true); });
+            else expand(false);
+            for (size_t w = 0; w < words; w++) {
+                frontier[w] = next[w].load(std::memory_order_relaxed);
+                visited[w] |= frontier[w];
+            }
+            frontierSize = nextSize;
+            frontierArcs = nextArcs;
+            unexploredArcs -= frontierArcs;
+        }
+        std::vector<bool> res(n, false);
+        for (size_t w = 0; w < words; w++)
+            for (uint64_t word = visited[w]; word != 0; word &= word - 1)
+                res[w * 64 + lowestBit(word)] = true;
+        return res;
+    }
+};
+
+
+#endif //RAILNETWORK_FRONTIER_H
@@ -0,0 +1,283 @@
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+#include "Json.h"
+
+using namespace std;
+
+
+Json::Json() : type(NUL), boolean(false), number(0) {}
+
+Json::Json(bool value) : type(BOOL), boolean(value), number(0) {}
+
+Json::Json(double value) : type(NUMBER), boolean(false), number(value) {}
+
+Json::Json(int value) : Json((double) value) {}
+
+Json::Json(unsigned value) : Json((double) value) {}
+
+Json::Json(unsigned long long value) : Json((double) value) {}
+
+Json::Json(string value) : type(STRING), boolean(false), number(0), str(std::move(value)) {}
+
+Json::Json(const char* value) : Json(string(value)) {}
+
+Json Json::array() {
+    Json res;
+    res.type = ARRAY;
+    return res;
+}
+
+Json Json::object() {
+    Json res;
+    res.type = OBJECT;
+    return res;
+}
+
+Json::Type Json::getType() const {
+    return type;
+}
+
+bool Json::isNull() const {
+    return type == NUL;
+}
+
+bool Json::has(const string &key) const {
+    if (type != OBJECT) return false;
+    for (const auto& [k, _] : obj)
+        if (k == key) return true;
+    return false;
+}
+
+const Json& Json::operator[](const string &key) const {
+    if (type == OBJECT)
+        for (const auto& [k, v] : obj)
+            if (k == key) return v;
+    throw invalid_argument("Missing \"" + key + "\".");
+}
+
+Json& Json::operator[](const string &key) {
+    if (type == NUL) type = OBJECT;
+    if (type != OBJECT) throw invalid_argument("Not an object.");
+    for (auto& [k, v] : obj)
+        if (k == key) return v;
+    obj.emplace_back(key, Json());
+    return obj.back().second;
+}
+
+void Json::push(Json value) {
+    if (type == NUL) type = ARRAY;
+    if (type != ARRAY) throw invalid_argument("Not an array.");
+    arr.push_back(std::move(value));
+}
+
+const vector<Json>& Json::items() const {
+    if (type != ARRAY) throw invalid_argument("Expected an array.");
+    return arr;
+}
+
+bool Json::asBool() const {
+    if (type != BOOL) throw invalid_argument("Expected a bool.");
+    return boolean;
+}
+
+double Json::asNumber() const {
+    if (type != NUMBER) throw invalid_argument("Expected a number.");
+    return number;
+}
+
+const string& Json::asString() const {
+    if (type != STRING) throw invalid_argument("Expected a string.");
+    return str;
+}
+
+// []===========================================[] //
+// ||                  WRITING                  || //
+// []===========================================[] //
+
+static void dumpString(const string& s, string& out) {
+    out.push_back('"');
+    for (char c : s) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char) c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char) c);
+                    out += buf;
+                } else out.push_back(c); // UTF-8 is kept as is
+        }
+    }
+    out.push_back('"');
+}
+
+string Json::dump() const {
+    string out;
+    dumpTo(out);
+    return out;
+}
+
+void Json::dumpTo(string &out) const {
+    switch (type) {
+        case NUL: out += "null"; break;
+        case BOOL: out += boolean ? "true" : "false"; break;
+        case NUMBER: {
+            char buf[32];
+            if (!isfinite(number)) snprintf(buf, sizeof(buf), "null");
+            else if (number == floor(number) && fabs(number) < 1e15) snprintf(buf, sizeof(buf), "%.0f", number);
+            else snprintf(buf, sizeof(buf), "%.15g", number);
+            out += buf;
+        } break;
+        case STRING: dumpString(str, out); break;
+        case ARRAY: {
+            out.push_back('[');
+            for (size_t i = 0; i < arr.size(); i++) {
+                if (i > 0) out.push_back(',');
+                arr[i].dumpTo(out);
+            }
+            out.push_back(']');
+        } break;
+        case OBJECT: {
+            out.push_back('{');
+            for (size_t i = 0; i < obj.size(); i++) {
+                if (i > 0) out.push_back(',');
+                dumpString(obj[i].first, out);
+                out.push_back(':');
+                obj[i].second.dumpTo(out);
+            }
+            out.push_back('}');
+        } break;
+    }
+}
+
+// []===========================================[] //
+// ||                  PARSING                  || //
+// []===========================================[] //
+
+static void skipSpaces(const string& text, size_t& pos) {
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+        pos++;
+}
+
+static void expect(const string& text, size_t& pos, const string& token) {
+    if (text.compare(pos, token.size(), token) != 0)
+        throw invalid_argument("Invalid JSON at position " + to_string(pos) + '.');
+    pos += token.size();
+}
+
+static void appendUtf8(unsigned code, string& out) {
+    if (code < 0x80) out.push_back((char) code);
+    else if (code < 0x800) {
+        out.push_back((char) (0xC0 | (code >> 6)));
+        out.push_back((char) (0x80 | (code & 0x3F)));
+    } else if (code < 0x10000) {
+        out.push_back((char) (0xE0 | (code >> 12)));
+        out.push_back((char) (0x80 | ((code >> 6) & 0x3F)));
+        out.push_back((char) (0x80 | (code & 0x3F)));
+    } else {
+        out.push_back((char) (0xF0 | (code >> 18)));
+        out.push_back((char) (0x80 | ((code >> 12) & 0x3F)));
+        out.push_back((char) (0x80 | ((code >> 6) & 0x3F)));
+        out.push_back((char) (0x80 | (code & 0x3F)));
+    }
+}
+
+static unsigned parseHex4(const string& text, size_t& pos) {
+    if (pos + 4 > text.size()) throw invalid_argument("Invalid JSON escape.");
+    unsigned code = stoul(text.substr(pos, 4), nullptr, 16);
+    pos += 4;
+    return code;
+}
+
+static string parseString(const string& text, size_t& pos) {
+    expect(text, pos, "\"");
+    string res;
+    while (true) {
+        if (pos >= text.size()) throw invalid_argument("Unterminated JSON string.");
+        char c = text[pos++];
+        if (c == '"') break;
+        if (c != '\\') { res.push_back(c); continue; }
+        if (pos >= text.size()) throw invalid_argument("Unterminated JSON string.");
+        switch (text[pos++]) {
+            case '"': res.push_back('"'); break;
+            case '\\': res.push_back('\\'); break;
+            case '/': res.push_back('/'); break;
+            case 'b': res.push_back('\b'); break;
+            case 'f': res.push_back('\f'); break;
+            case 'n': res.push_back('\n'); break;
+            case 'r': res.push_back('\r'); break;
+            case 't': res.push_back('\t'); break;
+            case 'u': {
+                unsigned code = parseHex4(text, pos);
+                if (code >= 0xD800 && code < 0xDC00 && text.compare(pos, 2, "\\u") == 0) { // Surrogate pair
+                    pos += 2;
+                    unsigned low = parseHex4(text, pos);
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(code, res);
+            } break;
+            default: throw invalid_argument("Invalid JSON escape.");
+        }
+    }
+    return res;
+}
+
+static Json parseValue(const string& text, size_t& pos, unsigned depth) {
+    if (depth > 64) throw invalid_argument("JSON nested too deep.");
+    skipSpaces(text, pos);
+    if (pos >= text.size()) throw invalid_argument("Unexpected end of JSON.");
+    char c = text[pos];
+    if (c == '{') {
+        pos++;
+        Json res = Json::object();
+        skipSpaces(text, pos);
+        if (pos < text.size() && text[pos] == '}') { pos++; return res; }
+        while (true) {
+            skipSpaces(text, pos);
+            string key = parseString(text, pos);
+            skipSpaces(text, pos);
+            expect(text, pos, ":");
+            res[key] = parseValue(text, pos, depth + 1);
+            skipSpaces(text, pos);
+            if (pos < text.size() && text[pos] == ',') { pos++; continue; }
+            expect(text, pos, "}");
+            return res;
+        }
+    }
+    if (c == '[') {
+        pos++;
+        Json res = Json::array();
+        skipSpaces(text, pos);
+        if (pos < text.size() && text[pos] == ']') { pos++; return res; }
+        while (true) {
+            res.push(parseValue(text, pos, depth + 1));
+            skipSpaces(text, pos);
+            if (pos < text.size() && text[pos] == ',') { pos++; continue; }
+            expect(text, pos, "]");
+            return res;
+        }
+    }
+    if (c == '"') return {parseString(text, pos)};
+    if (c == 't') { expect(text, pos, "true"); return {true}; }
+    if (c == 'f') { expect(text, pos, "false"); return {false}; }
+    if (c == 'n') { expect(text, pos, "null"); return {}; }
+    size_t end = pos;
+    while (end < text.size() && string("+-0123456789.eE").find(text[end]) != string::npos) end++;
+    if (end == pos) throw invalid_argument("Invalid JSON at position " + to_string(pos) + '.');
+    double n = stod(text.substr(pos, end - pos));
+    pos = end;
+    return {n};
+}
+
+Json Json::parse(const string &text) {
+    size_t pos = 0;
+    Json res = parseValue(text, pos, 0);
+    skipSpaces(text, pos);
+    if (pos != text.size()) throw invalid_argument("Trailing characters after JSON.");
+    return res;
+}
@@ -0,0 +1,112 @@
+#ifndef RAILNETWORK_JSON_H
+#define RAILNETWORK_JSON_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief A minimal JSON value, used by the server mode to read requests and write responses.
+ * Objects keep their keys in insertion order.
+ */
+class Json {
+public:
+    enum Type {
+        NUL,
+        BOOL,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+private:
+    Type type;
+    bool boolean;
+    double number;
+    std::string str;
+    std::vector<Json> arr;
+    std::vector<std::pair<std::string, Json>> obj;
+    /**
+     * @brief Appends the serialized value to out.
+     */
+    void dumpTo(std::string& out) const;
+public:
+    /**
+     * @brief Constructs a null value.
+     */
+    Json();
+    Json(bool value);
+    Json(double value);
+    Json(int value);
+    Json(unsigned value);
+    Json(unsigned long long value);
+    Json(std::string value);
+    Json(const char* value);
+    /**
+     * @brief Constructs an empty array.
+     */
+    static Json array();
+    /**
+     * @brief Constructs an empty object.
+     */
+    static Json object();
+    /**
+     * @brief Parses a JSON document.
+     * @param text The JSON text.
+     * @return The parsed value.
+     * @throws std::invalid_argument If the text isn't valid JSON.
+     */
+    static Json parse(const std::string& text);
+    /**
+     * @brief Serializes the value as compact JSON (one line).
+     * @return The JSON text.
+     */
+    std::string dump() const;
+
+    Type getType() const;
+    bool isNull() const;
+    /**
+     * @brief Checks if an object has the given key.
+     * @param key The key.
+     * @return True if this is an object and has the key.
+     */
+    bool has(const std::string& key) const;
+    /**
+     * @brief Gets the value of a key of an object.
+     * @param key The key.
+     * @return The value of the key.
+     * @throws std::invalid_argument If this isn't an object or doesn't have the key.
+     */
+    const Json& operator[](const std::string& key) const;
+    /**
+     * @brief Gets (inserting it if needed) the value of a key of an object.
+     * @param key The key.
+     * @return The value of the key.
+     */
+    Json& operator[](const std::string& key);
+    /**
+     * @brief Appends a value to an array.
+     * @param value The value to append.
+     */
+    void push(Json value);
+    /**
+     * @brief Gets the items of an array.
+     * @throws std::invalid_argument If this isn't an array.
+     */
+    const std::vector<Json>& items() const;
+    /**
+     * @throws std::invalid_argument If this isn't a bool.
+     */
+    bool asBool() const;
+    /**
+     * @throws std::invalid_argument If this isn't a number.
+     */
+    double asNumber() const;
+    /**
+     * @throws std::invalid_argument If this isn't a string.
+     */
+    const std::string& asString() const;
+};
+
+
+#endif //RAILNETWORK_JSON_H
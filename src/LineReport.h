@@ -0,0 +1,46 @@
+#ifndef RAILNETWORK_LINEREPORT_H
+#define RAILNETWORK_LINEREPORT_H
+
+#include <list>
+#include <string>
+
+#include "Segment.h"
+
+/**
+ * @brief The capacity a railway line offers to trains changing to another line at one of its junction stations.
+ */
+struct LineTransfer {
+    std::string station; // The junction, on this line
+    std::string line; // The other line
+    unsigned capacity; // Of the segments from the junction to stations of the other line
+};
+
+/**
+ * @brief A stretch of a railway line that its trains can run end to end.
+ * The terminals are the two stations of the line in the piece farthest apart in segments, found by a double sweep, so
+ * on a stretch without branches they are its two ends. The bottlenecks are the saturated segments of the cut left by
+ * the flow.
+ */
+struct LinePiece {
+    unsigned stations = 0; // Of the line, without the junctions crossed
+    std::string origin; // First terminal
+    std::string destination; // Last terminal
+    unsigned flow = 0; // End to end, from the first terminal to the last (0 if no one service runs all the way)
+    std::list<Segment> bottlenecks;
+};
+
+/**
+ * @brief Throughput of a railway line on its own segments and the junctions next to them.
+ * Every station belongs to one line, so a line runs through the stations of other lines where they meet; its trains
+ * may cross those junction stations (on the segments from or to a station of the line). Where another line runs a
+ * longer stretch, the line is split in pieces, each reported on its own.
+ */
+struct LineReport {
+    std::string line;
+    unsigned stations = 0;
+    std::list<LinePiece> pieces; // Largest first
+    std::list<LineTransfer> transfers; // By junction, then by other line
+};
+
+
+#endif //RAILNETWORK_LINEREPORT_H
@@ -0,0 +1,20 @@
+#ifndef RAILNETWORK_MINCUT_H
+#define RAILNETWORK_MINCUT_H
+
+#include <list>
+#include <string>
+
+#include "Segment.h"
+
+/**
+ * @brief Represents the cut left by a max flow query.
+ * The source side holds the stations still reachable from the origin in the final residual graph, and the segments
+ * are the saturated ones that separate them from the rest of the network (the bottlenecks of the flow).
+ */
+struct MinCut {
+    std::list<std::string> sourceSide;
+    std::list<Segment> segments;
+};
+
+
+#endif //RAILNETWORK_MINCUT_H
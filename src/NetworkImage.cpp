@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "NetworkImage.h"
+#include "PathSearch.h"
+#include "RailNetwork.h"
+
+using namespace std;
+
+static const char imageMagic[8] = {'R', 'A', 'I', 'L', 'I', 'M', 'G', '1'};
+
+static uint64_t alignUp(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t) 7;
+}
+
+// []===========================================[] //
+// ||                  LAYOUT                   || //
+// []===========================================[] //
+
+bool NetworkImage::write(const string &path, const RailNetwork &network, const unordered_map<string, Station> &stationData) {
+    // Stations get ids in the order of the network's nodes, so twins pair up as in RailNetwork::linkTwins
+    vector<const RailNetwork::Node*> nodes;
+    unordered_map<string, uint32_t> ids;
+    for (const auto& [name, node] : network.nodes) {
+        ids.emplace(name, (uint32_t) nodes.size());
+        nodes.push_back(&node);
+    }
+    const uint32_t n = (uint32_t) nodes.size();
+
+    string strings;
+    unordered_map<string, uint32_t> interned;
+    auto intern = [&strings, &interned](const string& s) {
+        auto [it, added] = interned.emplace(s, (uint32_t) strings.size());
+        if (added) strings.append(s).push_back('\0');
+        return it->second;
+    };
+    vector<StationRecord> records(n);
+    for (uint32_t id = 0; id < n; id++) {
+        const string& name = nodes[id]->name;
+        records[id].name = intern(name);
+        auto it = stationData.find(name);
+        const Station station = it == stationData.end() ? Station(name, "", "", "", "") : it->second;
+        records[id].district = intern(station.district);
+        records[id].municipality = intern(station.municipality);
+        records[id].township = intern(station.township);
+        records[id].line = intern(station.line);
+    }
+    vector<uint32_t> byName(n);
+    for (uint32_t id = 0; id < n; id++) byName[id] = id;
+    sort(byName.begin(), byName.end(), [&nodes](uint32_t a, uint32_t b) { return nodes[a]->name < nodes[b]->name; });
+
+    vector<uint32_t> arcStart(n + 1, 0);
+    vector<Arc> arcs;
+    for (uint32_t id = 0; id < n; id++) {
+        for (const RailNetwork::Edge& edge : nodes[id]->adj) {
+            auto target = ids.find(*edge.dest);
+            if (target == ids.end()) return false;
+            arcs.push_back({target->second, edge.capacity, (uint32_t) edge.type, none});
+        }
+        arcStart[id + 1] = (uint32_t) arcs.size();
+    }
+    for (uint32_t id = 0; id < n; id++)
+        for (uint32_t a = arcStart[id]; a < arcStart[id + 1]; a++) {
+            if (arcs[a].twin != none) continue;
+            const uint32_t to = arcs[a].target;
+            for (uint32_t b = arcStart[to]; b < arcStart[to + 1]; b++)
+                if (arcs[b].twin == none && arcs[b].target == id && b != a) {
+                    arcs[a].twin = b;
+                    arcs[b].twin = a;
+                    break;
+                }
+        }
+
+    Header header{};
+    memcpy(header.magic, imageMagic, sizeof(imageMagic));
+    header.version = version;
+    header.policy = (uint32_t) network.capacityPolicy;
+    header.stations = n;
+    header.arcs = (uint32_t) arcs.size();
+    header.stationsAt = alignUp(sizeof(Header));
+    header.byNameAt = alignUp(header.stationsAt + records.size() * sizeof(StationRecord));
+    header.arcStartAt = alignUp(header.byNameAt + byName.size() * sizeof(uint32_t));
+    header.arcsAt = alignUp(header.arcStartAt + arcStart.size() * sizeof(uint32_t));
+    header.stringsAt = alignUp(header.arcsAt + arcs.size() * sizeof(Arc));
+    header.size = header.stringsAt + strings.size();
+
+    // Written aside and renamed over the old file, so attaching never sees a half-written image
+    const string temporary = path + ".tmp";
+    {
+        ofstream out(temporary, ios::binary | ios::trunc);
+        if (!out) return false;
+        uint64_t at = 0;
+        auto put = [&out, &at](uint64_t offset, const void* data, size_t size) {
+            static const char padding[8] = {};
+            out.write(padding, (streamsize) (offset - at));
+            out.write((const char*) data, (streamsize) size);
+            at = offset + size;
+        };
+        put(0, &header, sizeof(header));
+        put(header.stationsAt, records.data(), records.size() * sizeof(StationRecord));
+        put(header.byNameAt, byName.data(), byName.size() * sizeof(uint32_t));
+        put(header.arcStartAt, arcStart.data(), arcStart.size() * sizeof(uint32_t));
+        put(header.arcsAt, arcs.data(), arcs.size() * sizeof(Arc));
+        put(header.stringsAt, strings.data(), strings.size());
+        if (!out.flush()) return false;
+    }
+#ifdef _WIN32
+    remove(path.c_str()); // Windows doesn't rename over an existing file
+#endif
+    return rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+// []===========================================[] //
+// ||                 MAPPING                   || //
+// []===========================================[] //
+
+#ifdef _WIN32
+
+NetworkImage::Mapping::~Mapping() {
+    if (base != nullptr) UnmapViewOfFile(base);
+}
+
+static bool mapFile(const string& path, const char*& base, size_t& size) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER length;
+    HANDLE mapping = GetFileSizeEx(file, &length) && length.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file);
+    if (mapping == nullptr) return false;
+    base = (const char*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping); // The view keeps the mapping alive
+    size = (size_t) length.QuadPart;
+    return base != nullptr;
+}
+
+#else
+
+NetworkImage::Mapping::~Mapping() {
+    if (base != nullptr) munmap((void*) base, size);
+}
+
+static bool mapFile(const string& path, const char*& base, size_t& size) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info{};
+    void* address = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+        address = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file alive
+    if (address == MAP_FAILED) return false;
+    base = (const char*) address;
+    size = (size_t) info.st_size;
+    return true;
+}
+
+#endif
+
+// Queries trust the image, so every offset and id in it is checked once here
+bool NetworkImage::valid(const Header& head, const StationRecord* records, const uint32_t* sorted, const uint32_t* starts, const Arc* edges, const char* table) {
+    // Every string ends within the table, as its last byte is a NUL
+    const uint64_t tableSize = head.size - head.stringsAt;
+    if (tableSize > 0 && table[tableSize - 1] != '\0') return false;
+    for (uint32_t id = 0; id < head.stations; id++) {
+        const StationRecord& record = records[id];
+        for (uint32_t offset : {record.name, record.district, record.municipality, record.township, record.line})
+            if (offset >= tableSize) return false;
+    }
+    // The ids by name are every id once, as the names are strictly increasing and each id has one name
+    for (uint32_t i = 0; i < head.stations; i++) {
+        if (sorted[i] >= head.stations) return false;
+        if (i > 0 && !(string_view(table + records[sorted[i - 1]].name) < string_view(table + records[sorted[i]].name))) return false;
+    }
+    if (starts[0] != 0 || starts[head.stations] != head.arcs) return false;
+    for (uint32_t id = 0; id < head.stations; id++)
+        if (starts[id] > starts[id + 1]) return false;
+    for (uint32_t id = 0; id < head.stations; id++)
+        for (uint32_t a = starts[id]; a < starts[id + 1]; a++) {
+            const Arc& arc = edges[a];
+            if (arc.target >= head.stations || arc.type > ALFA_PENDULAR) return false;
+            if (arc.twin == none) continue;
+            // Twins point at each other, the opposite way
+            if (arc.twin >= head.arcs || arc.twin == a || edges[arc.twin].twin != a || edges[arc.twin].target != id) return false;
+        }
+    return true;
+}
+
+bool NetworkImage::attach(const string &path) {
+    *this = NetworkImage();
+    auto map = make_shared<Mapping>();
+    if (!mapFile(path, map->base, map->size)) return false;
+    const auto* head = (const Header*) map->base;
+    auto fits = [&map](uint64_t offset, uint64_t count, uint64_t size) {
+        return offset % 8 == 0 && offset <= map->size && count <= (map->size - offset) / size;
+    };
+    if (map->size < sizeof(Header) || memcmp(head->magic, imageMagic, sizeof(imageMagic)) != 0) return false;
+    if (head->version != version || head->size != map->size || head->policy > SHARED) return false;
+    if (!fits(head->stationsAt, head->stations, sizeof(StationRecord)) || !fits(head->byNameAt, head->stations, sizeof(uint32_t)) ||
+        !fits(head->arcStartAt, (uint64_t) head->stations + 1, sizeof(uint32_t)) || !fits(head->arcsAt, head->arcs, sizeof(Arc)) ||
+        head->stringsAt > map->size) return false;
+    const auto* records = (const StationRecord*) (map->base + head->stationsAt);
+    const auto* sorted = (const uint32_t*) (map->base + head->byNameAt);
+    const auto* starts = (const uint32_t*) (map->base + head->arcStartAt);
+    const auto* edges = (const Arc*) (map->base + head->arcsAt);
+    const char* table = map->base + head->stringsAt;
+    if (!valid(*head, records, sorted, starts, edges, table)) return false;
+
+    mapping = std::move(map);
+    header = head;
+    stations = records;
+    byName = sorted;
+    arcStart = starts;
+    arcs = edges;
+    strings = table;
+    flow.assign(header->arcs, 0);
+    flowStamp.assign(header->arcs, 0);
+    visitedStamp.assign((size_t) header->stations * 3, 0);
+    prevStamp.assign((size_t) header->stations * 3, 0);
+    prevNode.assign((size_t) header->stations * 3, 0);
+    prevArc.assign((size_t) header->stations * 3, 0);
+    return true;
+}
+
+bool NetworkImage::attached() const {
+    return header != nullptr;
+}
+
+// []===========================================[] //
+// ||                 QUERIES                   || //
+// []===========================================[] //
+
+size_t NetworkImage::size() const {
+    return header == nullptr ? 0 : header->stations;
+}
+
+uint32_t NetworkImage::find(const string &name) const {
+    const uint32_t* end = byName + size();
+    const uint32_t* it = lower_bound(byName, end, name, [this](uint32_t id, const string& key) {
+        return string_view(strings + stations[id].name) < key;
+    });
+    if (it == end || strings + stations[*it].name != name) return none;
+    return *it;
+}
+
+Station NetworkImage::station(uint32_t id) const {
+    const StationRecord& record = stations[id];
+    return {strings + record.name, strings + record.district, strings + record.municipality, strings + record.township, strings + record.line};
+}
+
+Segment NetworkImage::segment(uint32_t origin, uint32_t destination) const {
+    for (uint32_t a = arcStart[origin]; a < arcStart[origin + 1]; a++)
+        if (arcs[a].target == destination)
+            return {strings + stations[origin].name, strings + stations[destination].name, arcs[a].capacity, (SegmentType) arcs[a].type};
+    throw out_of_range("No segment from " + string(strings + stations[origin].name) + " to " + string(strings + stations[destination].name) + ".");
+}
+
+void NetworkImage::nextEpoch(unsigned &epoch, vector<unsigned> &stamps) {
+    if (++epoch != 0) return;
+    fill(stamps.begin(), stamps.end(), 0);
+    epoch = 1;
+}
+
+unsigned NetworkImage::getFlow(uint32_t arc) const {
+    return flowStamp[arc] == flowEpoch ? flow[arc] : 0;
+}
+
+void NetworkImage::addFlow(uint32_t arc, unsigned amount) {
+    if (flowStamp[arc] != flowEpoch) {
+        flow[arc] = 0;
+        flowStamp[arc] = flowEpoch;
+    }
+    flow[arc] += amount;
+    if (header->policy != SHARED) return;
+    const uint32_t twin = arcs[arc].twin;
+    if (twin == none) return;
+    if (flowStamp[twin] != flowEpoch) {
+        flow[twin] = 0;
+        flowStamp[twin] = flowEpoch;
+    }
+    flow[twin] += amount;
+}
+
+// The walk typedPath shares with RailNetwork, with the state of each station and type of train at id * 3 + type
+struct NetworkImage::PathGraph {
+    using Vertex = uint32_t;
+    using Arc = uint32_t;
+    NetworkImage& image;
+    void restart() {
+        nextEpoch(image.visitEpoch, image.visitedStamp);
+        nextEpoch(image.prevEpoch, image.prevStamp);
+    }
+    bool visited(uint32_t node, SegmentType type) const { return image.visitedStamp[(size_t) node * 3 + type] == image.visitEpoch; }
+    void visit(uint32_t node, SegmentType type) { image.visitedStamp[(size_t) node * 3 + type] = image.visitEpoch; }
+    template<class G>
+    void forEachArc(uint32_t node, G g) {
+        for (uint32_t a = image.arcStart[node]; a < image.arcStart[node + 1]; a++)
+            if (g(a)) return;
+    }
+    SegmentType type(uint32_t arc) const { return (SegmentType) image.arcs[arc].type; }
+    uint32_t target(uint32_t arc) const { return image.arcs[arc].target; }
+    void setPrev(uint32_t node, uint32_t prev, uint32_t arc, SegmentType type) {
+        const size_t slot = (size_t) node * 3 + type;
+        image.prevNode[slot] = prev;
+        image.prevArc[slot] = arc;
+        image.prevStamp[slot] = image.prevEpoch;
+    }
+    bool getPrev(uint32_t node, SegmentType type, uint32_t& prev, uint32_t& arc) const {
+        const size_t slot = (size_t) node * 3 + type;
+        if (image.prevStamp[slot] != image.prevEpoch) return false;
+        prev = image.prevNode[slot];
+        arc = image.prevArc[slot];
+        return true;
+    }
+};
+
+vector<uint32_t> NetworkImage::BFSFlow(uint32_t source, uint32_t destination) {
+    PathGraph graph{*this};
+    return typedPath(graph, source, destination, [this](uint32_t, uint32_t arc) {
+        return arcs[arc].capacity - getFlow(arc) >= 1;
+    });
+}
+
+unsigned NetworkImage::maxFlow(uint32_t origin, uint32_t destination, const Cancellation& control) {
+    nextEpoch(flowEpoch, flowStamp);
+    unsigned maxFlow = 0;
+    while (!control.stop()) {
+        vector<uint32_t> path = BFSFlow(origin, destination);
+        if (path.empty()) break;
+        unsigned bottleneck = UINT_MAX;
+        for (uint32_t a : path)
+            bottleneck = min(bottleneck, arcs[a].capacity - getFlow(a));
+        for (uint32_t a : path)
+            addFlow(a, bottleneck);
+        maxFlow += bottleneck;
+    }
+    return maxFlow;
+}
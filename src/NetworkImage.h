@@ -0,0 +1,177 @@
+#ifndef RAILNETWORK_NETWORKIMAGE_H
+#define RAILNETWORK_NETWORKIMAGE_H
+
+#include <cstddef>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Cancellation.h"
+#include "Segment.h"
+#include "Station.h"
+
+class RailNetwork;
+
+/**
+ * @brief A loaded network laid out in one read-only file that many processes can map at once: attaching parses
+ * nothing, and the host keeps a single physical copy of the network however many workers attach to it.
+ * The layout only holds offsets from its start, never pointers, so it works wherever it is mapped: a header, the
+ * stations by id (their name and attributes as offsets in a string table), the ids sorted by name (for lookups by
+ * binary search), and the edges of every station in compressed sparse rows, in the order the network searches them so
+ * the flows come out the same. Each copy of an image shares the mapping and keeps its own scratch state for queries.
+ */
+class NetworkImage {
+    static const uint32_t version = 1;
+    static const uint32_t none = UINT32_MAX;
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t policy;
+        uint32_t stations;
+        uint32_t arcs;
+        uint64_t stationsAt; // Offsets of the sections from the start of the file
+        uint64_t byNameAt;
+        uint64_t arcStartAt;
+        uint64_t arcsAt;
+        uint64_t stringsAt;
+        uint64_t size;
+    };
+    struct StationRecord {
+        uint32_t name; // Offsets in the string table
+        uint32_t district;
+        uint32_t municipality;
+        uint32_t township;
+        uint32_t line;
+    };
+    struct Arc {
+        uint32_t target;
+        uint32_t capacity;
+        uint32_t type;
+        uint32_t twin; // The arc of the same segment the other way, or none
+    };
+    /**
+     * @brief A read-only mapping of a whole file, unmapped with its last image.
+     */
+    struct Mapping {
+        const char* base = nullptr;
+        size_t size = 0;
+        Mapping() = default;
+        Mapping(const Mapping&) = delete;
+        Mapping& operator=(const Mapping&) = delete;
+        ~Mapping();
+    };
+    std::shared_ptr<const Mapping> mapping;
+    const Header* header = nullptr;
+    const StationRecord* stations = nullptr;
+    const uint32_t* byName = nullptr;
+    const uint32_t* arcStart = nullptr;
+    const Arc* arcs = nullptr;
+    const char* strings = nullptr;
+    // Scratch state of the queries, per copy. Like the network's, it is only valid while its stamp matches the epoch.
+    std::vector<unsigned> flow, flowStamp; // Of each arc
+    std::vector<unsigned> visitedStamp, prevStamp, prevNode, prevArc; // Of each station and type of train
+    unsigned flowEpoch = 0, visitEpoch = 0, prevEpoch = 0;
+    /**
+     * @brief Starts a new epoch, clearing every stamp if the counter wraps around.
+     * @param epoch The epoch counter.
+     * @param stamps The stamps of that epoch.
+     */
+    static void nextEpoch(unsigned& epoch, std::vector<unsigned>& stamps);
+    /**
+     * @brief Returns the flow of an arc in the current flow epoch (both ways, if the capacity is shared).
+     * @param arc The id of the arc.
+     * @return The flow.
+     */
+    unsigned getFlow(uint32_t arc) const;
+    /**
+     * @brief Adds flow to an arc, and to its twin if they share the capacity.
+     * @param arc The id of the arc.
+     * @param amount The flow to add.
+     */
+    void addFlow(uint32_t arc, unsigned amount);
+    struct PathGraph; // How typedPath (see PathSearch.h) walks the arcs
+    /**
+     * @brief Finds the shortest path with capacity left from one station to another, by the same search as the
+     * network's BFSFlow.
+     * @param source The id of the origin station.
+     * @param destination The id of the destination station.
+     * @return The arcs of the path, in order, or none if there is no path.
+     */
+    std::vector<uint32_t> BFSFlow(uint32_t source, uint32_t destination);
+    /**
+     * @brief Checks everything inside the sections of an image, which are already known to fit in it: the strings end
+     * in the table, the ids by name are sorted and in range, the rows of arcs are in order, and every arc has a valid
+     * target, type and twin.
+     * @param head The header.
+     * @param records The stations.
+     * @param sorted The ids sorted by name.
+     * @param starts The start of the arcs of each station.
+     * @param edges The arcs.
+     * @param table The string table.
+     * @return True if the image can be queried safely.
+     */
+    static bool valid(const Header& head, const StationRecord* records, const uint32_t* sorted, const uint32_t* starts, const Arc* edges, const char* table);
+public:
+    /**
+     * @brief Default constructor. Creates an image that isn't attached to any file.
+     */
+    NetworkImage() = default;
+    /**
+     * @brief Lays out a network in a file, replacing it whole (processes attached to the old file keep their copy).
+     * @param path The path of the file.
+     * @param network The network, with a node for every station.
+     * @param stationData The stations of the network.
+     * @return False if the file couldn't be written.
+     */
+    static bool write(const std::string& path, const RailNetwork& network, const std::unordered_map<std::string, Station>& stationData);
+    /**
+     * @brief Maps a file written by write, read-only, detaching from the previous one.
+     * @param path The path of the file.
+     * @return False if the file couldn't be mapped or isn't a valid network image.
+     */
+    bool attach(const std::string& path);
+    /**
+     * @brief Checks if the image is attached to a file.
+     * @return True if it is.
+     */
+    bool attached() const;
+    /**
+     * @brief Returns the number of stations.
+     * @return The number of stations.
+     */
+    size_t size() const;
+    /**
+     * @brief Finds a station by name.
+     * @param name The name of the station.
+     * @return The id of the station, or UINT32_MAX if there is none.
+     */
+    uint32_t find(const std::string& name) const;
+    /**
+     * @brief Returns a station.
+     * @param id The id of the station.
+     * @return A copy of the station.
+     */
+    Station station(uint32_t id) const;
+    /**
+     * @brief Returns the segment from one station to another.
+     * @param origin The id of the origin station.
+     * @param destination The id of the destination station.
+     * @return A copy of the segment.
+     * @throws std::out_of_range If there is no such segment.
+     */
+    Segment segment(uint32_t origin, uint32_t destination) const;
+    /**
+     * @brief Calculates the maximum flow between two stations, by the same augmenting paths as the network's maxFlow.
+     * @param origin The id of the origin station.
+     * @param destination The id of the destination station.
+     * @param control Stops the search early, keeping the flow found so far.
+     * @return The maximum flow.
+     */
+    unsigned maxFlow(uint32_t origin, uint32_t destination, const Cancellation& control = Cancellation::none());
+};
+
+
+#endif //RAILNETWORK_NETWORKIMAGE_H
@@ -0,0 +1,51 @@
+#ifndef RAILNETWORK_PARALLEL_H
+#define RAILNETWORK_PARALLEL_H
+
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * The Parallel namespace groups up the helpers used to spread independent jobs across all cores.
+ */
+namespace Parallel {
+    /**
+     * @brief Number of workers worth spawning for the given number of jobs.
+     * @param jobs The number of independent jobs.
+     * @return Between 1 and the number of hardware threads (never more than jobs).
+     */
+    inline unsigned workerCount(size_t jobs) {
+        unsigned hw = std::thread::hardware_concurrency();
+        if (hw == 0) hw = 1;
+        return (unsigned) std::max<size_t>(1, std::min<size_t>(hw, jobs));
+    }
+    /**
+     * @brief Runs f(worker) on the given number of threads and waits for all of them.
+     * The first exception thrown by a worker is rethrown on the calling thread.
+     * @tparam F void(unsigned worker)
+     * @param workers The number of threads to run.
+     * @param f The body of each worker.
+     */
+    template <class F>
+    void forEachWorker(unsigned workers, F f) {
+        if (workers <= 1) { f(0); return; }
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        std::vector<std::thread> threads;
+        threads.reserve(workers);
+        for (unsigned w = 0; w < workers; w++)
+            threads.emplace_back([&, w]() {
+                try { f(w); }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) error = std::current_exception();
+                }
+            });
+        for (std::thread& t : threads) t.join();
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+#endif //RAILNETWORK_PARALLEL_H
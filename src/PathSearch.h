@@ -0,0 +1,72 @@
+#ifndef RAILNETWORK_PATHSEARCH_H
+#define RAILNETWORK_PATHSEARCH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "Segment.h"
+
+/**
+ * @brief Uses Breadth-First Search to find the shortest path from one node to another in which the train keeps its
+ * service type, following only the arcs the filter allows. Every representation of the network searches through this
+ * one function, so they find the same augmenting paths and their flows come out the same.
+ * A train that leaves the source has no type yet (INVALID) and takes the type of its first arc; a node is visited once
+ * per type, and not at all by a typed train once an untyped one reached it. The path is read back with the type of
+ * the train that reached the destination (Alfa if both did).
+ * The graph walks itself and keeps the search state, through:
+ * - Vertex and Arc, cheap to copy, with Vertex comparable;
+ * - void restart(), which forgets every visit and prev;
+ * - bool visited(Vertex, SegmentType) const and void visit(Vertex, SegmentType);
+ * - void forEachArc(Vertex, G g), calling g(Arc) on the arcs leaving the vertex, in order, until it returns true;
+ * - SegmentType type(Arc) const and Vertex target(Arc);
+ * - void setPrev(Vertex to, Vertex from, Arc arc, SegmentType type) and
+ *   bool getPrev(Vertex to, SegmentType type, Vertex& from, Arc& arc) const, false if it has none.
+ * @tparam Graph The graph.
+ * @tparam F bool(Vertex from, Arc arc)
+ * @param graph The graph.
+ * @param source The source node.
+ * @param destination The destination node.
+ * @param usable The filter.
+ * @return The arcs of the path, in order, or none if there is no path.
+ */
+template<class Graph, class F>
+std::vector<typename Graph::Arc> typedPath(Graph& graph, typename Graph::Vertex source, typename Graph::Vertex destination, F usable) {
+    using Vertex = typename Graph::Vertex;
+    using Arc = typename Graph::Arc;
+    graph.restart();
+    std::vector<std::pair<Vertex, SegmentType>> q = {{source, INVALID}}; // Popped by moving head
+    graph.visit(source, INVALID);
+    bool found = false;
+    for (size_t head = 0; head < q.size() && !found; head++) { // No more nodes
+        const Vertex curr = q[head].first;
+        const SegmentType type = q[head].second;
+        graph.visit(curr, type);
+        graph.forEachArc(curr, [&](Arc arc) {
+            const SegmentType arcType = graph.type(arc);
+            if (type != INVALID && type != arcType) return false; // Different Train
+            if (!usable(curr, arc)) return false;
+            const Vertex next = graph.target(arc);
+            if (graph.visited(next, INVALID) || graph.visited(next, arcType)) return false;
+            graph.setPrev(next, curr, arc, arcType);
+            q.emplace_back(next, arcType);
+            found = next == destination;
+            return found;
+        });
+    }
+    std::vector<Arc> res;
+    if (!found) return res;
+    Vertex from{};
+    Arc arc{};
+    const SegmentType type = graph.getPrev(destination, ALFA_PENDULAR, from, arc) ? ALFA_PENDULAR : STANDARD;
+    for (Vertex node = destination; node != source; node = from) {
+        if (!graph.getPrev(node, type, from, arc) && !graph.getPrev(node, INVALID, from, arc)) return {};
+        res.push_back(arc);
+    }
+    std::reverse(res.begin(), res.end());
+    return res;
+}
+
+
+#endif //RAILNETWORK_PATHSEARCH_H
@@ -1,5 +1,10 @@
 
+#include <algorithm>
+#include <climits>
 #include <iostream>
+#include <queue>
+#include <stdexcept>
+#include <unordered_set>
 
 #include "RailManager.h"
 using namespace std;
@@ -12,20 +17,57 @@ RailManager::RailManager(const string& datasetPath) {
 }
 
 void RailManager::addSegment(const string& stationA, const string& stationB, unsigned int capacity, SegmentType service) {
-    segments[stationA].insert({stationB, Segment(stationA, stationB, capacity, service)});
-    segments[stationB].insert({stationA, Segment(stationB, stationA, capacity, service)});
+    unsigned id = (unsigned) segments->size();
+    segments.edit().emplace_back(stationA, stationB, capacity, service);
+    unordered_map<string, vector<unsigned>>& ids = incident.edit();
+    ids[stationA].push_back(id);
+    if (stationB != stationA) ids[stationB].push_back(id);
+}
+
+unsigned RailManager::findSegment(const string &stationA, const string &stationB) const {
+    auto it = incident->find(stationA);
+    if (it == incident->end()) return UINT_MAX;
+    for (unsigned id : it->second) {
+        const Segment& segment = (*segments)[id];
+        if ((segment.origin == stationA && segment.destination == stationB) || (segment.origin == stationB && segment.destination == stationA))
+            return id;
+    }
+    return UINT_MAX;
+}
+
+void RailManager::eraseSegment(unsigned id) {
+    vector<Segment>& all = segments.edit();
+    unordered_map<string, vector<unsigned>>& byStation = incident.edit();
+    auto unlink = [&byStation](const string& station, unsigned segment) {
+        vector<unsigned>& ids = byStation.at(station);
+        ids.erase(find(ids.begin(), ids.end(), segment));
+    };
+    unlink(all[id].origin, id);
+    if (all[id].destination != all[id].origin) unlink(all[id].destination, id);
+    unsigned last = (unsigned) all.size() - 1;
+    if (id != last) {
+        for (const string* station : {&all[last].origin, &all[last].destination})
+            for (unsigned& other : byStation.at(*station))
+                if (other == last) other = id;
+        all[id] = std::move(all[last]);
+    }
+    all.pop_back();
 }
 
 void RailManager::addStation(const string& name, const string& district, const string& municipality, const string& township, const string& line){
-    stations.insert({name, Station(name, district, municipality, township, line)});
+    auto [it, added] = stations.edit().insert({name, Station(name, district, municipality, township, line)});
+    if (added) stationIndex.edit().add(it->second);
 }
 
-const Segment& RailManager::getSegment(const string &origin, const string &destination) {
-    return segments.at(origin).at(destination);
+Segment RailManager::getSegment(const string &origin, const string &destination) {
+    unsigned id = findSegment(origin, destination);
+    if (id == UINT_MAX) throw out_of_range("No segment between " + origin + " and " + destination + ".");
+    const Segment& segment = (*segments)[id];
+    return {origin, destination, segment.capacity, segment.service};
 }
 
 const Station &RailManager::getStation(const std::string &station) {
-    return stations.at(station);
+    return stations->at(station);
 }
 
 void RailManager::initializeStations(const CSV &stationsCSV) {
@@ -45,7 +87,7 @@ void RailManager::initializeStations(const CSV &stationsCSV) {
             continue;
         }
         // Check If Already Added
-        if (stations.find(line[0]) != stations.end()) {
+        if (stations->find(line[0]) != stations->end()) {
             repeatedCount++;
             continue;
         }
@@ -71,7 +113,7 @@ void RailManager::initializeSegments(const CSV &networkCSV) {
             continue;
         }
         // Check If Already Added
-        if (segments.find(line[0]) != segments.end() && (segments.at(line[0]).find(line[1]) != segments.at(line[0]).end())) {
+        if (findSegment(line[0], line[1]) != UINT_MAX) {
             repeatedCount++;
             continue;
         }
@@ -83,99 +125,388 @@ void RailManager::initializeSegments(const CSV &networkCSV) {
     cout << "network.csv Report:\nEmpty Entries: " << emptyCount << "\nRepeated Entries: " << repeatedCount << '\n' << endl;
 }
 
+/**
+ * @brief Orders the stations by reverse Cuthill-McKee: a BFS from a station of least degree in each component,
+ * visiting neighbours by increasing degree, then reversed. Stations close in the network end up close in the order.
+ * @param stations The stations.
+ * @param segments The segments.
+ * @param incident The segments of each station.
+ * @return The names of the stations, in order.
+ */
+static vector<string> localityOrder(const unordered_map<string, Station>& stations, const vector<Segment>& segments, const unordered_map<string, vector<unsigned>>& incident) {
+    auto degree = [&incident](const string& station) {
+        auto it = incident.find(station);
+        return it == incident.end() ? (size_t) 0 : it->second.size();
+    };
+    auto byDegree = [&degree](const string* a, const string* b) {
+        size_t da = degree(*a), db = degree(*b);
+        return da != db ? da < db : *a < *b;
+    };
+    vector<const string*> starts;
+    for (const auto& [name, _] : stations)
+        starts.push_back(&name);
+    sort(starts.begin(), starts.end(), byDegree);
+    vector<string> order;
+    order.reserve(stations.size());
+    unordered_set<string> visited;
+    for (const string* start : starts) {
+        if (!visited.insert(*start).second) continue;
+        queue<const string*> q;
+        q.push(start);
+        while (!q.empty()) {
+            const string* curr = q.front();
+            q.pop();
+            order.push_back(*curr);
+            auto it = incident.find(*curr);
+            if (it == incident.end()) continue;
+            vector<const string*> next;
+            for (unsigned id : it->second) {
+                const Segment& segment = segments[id];
+                const string& dest = segment.origin == *curr ? segment.destination : segment.origin;
+                if (stations.count(dest) && visited.insert(dest).second) next.push_back(&dest);
+            }
+            sort(next.begin(), next.end(), byDegree);
+            for (const string* station : next)
+                q.push(station);
+        }
+    }
+    reverse(order.begin(), order.end());
+    return order;
+}
+
+/**
+ * @brief Orders the segments of a station as the hash map of its neighbours iterates them, when they are inserted in
+ * load order. Segments used to be stored in such maps, one per station, and the augmenting paths depend on the order
+ * of the edges, so building them in this order keeps every flow the same.
+ * @param station The station.
+ * @param segments The segments.
+ * @param ids The segments of the station, in load order.
+ * @return The ids of the segments, in order.
+ */
+static vector<unsigned> adjacencyOrder(const string& station, const vector<Segment>& segments, const vector<unsigned>& ids) {
+    unordered_map<string, unsigned> byNeighbour;
+    for (unsigned id : ids)
+        byNeighbour.emplace(segments[id].origin == station ? segments[id].destination : segments[id].origin, id);
+    vector<unsigned> order;
+    order.reserve(byNeighbour.size());
+    for (const auto& [_, id] : byNeighbour)
+        order.push_back(id);
+    return order;
+}
+
 void RailManager::initializeNetwork() {
-    for (const auto& [name, station] : stations) {
+    // Nodes and their edges are allocated in insertion order, so neighbours end up close in memory
+    // Each segment gives an edge each way, from the one record of it
+    railNet.nodes.reserve(stations->size());
+    railNet.capacityPolicy = capacityPolicy;
+    for (const string& name : localityOrder(*stations, *segments, *incident)) {
         list<RailNetwork::Edge> l;
-        for (const auto& [dest, seg] : segments[name])
-            l.emplace_back(name, dest, seg.service, seg.capacity);
+        auto it = incident->find(name);
+        if (it != incident->end())
+            for (unsigned id : adjacencyOrder(name, *segments, it->second)) {
+                const Segment& seg = (*segments)[id];
+                l.emplace_back(railNet.intern(seg.origin == name ? seg.destination : seg.origin), seg.service, seg.capacity);
+            }
         railNet.addNode(name, l);
     }
 }
 
+// Each structure is built on first use. A dataset without stations has nothing to build, so it counts as built.
+
+RailNetwork &RailManager::network() {
+    if (railNet.nodes.empty() && !stations->empty()) initializeNetwork();
+    return railNet;
+}
+
+RailNetwork &RailManager::componentsNetwork() {
+    RailNetwork& graph = network();
+    if (graph.components->empty() && !stations->empty()) graph.components = ComponentIndex(graph);
+    return graph;
+}
+
+RailNetwork &RailManager::blockIndexedNetwork() {
+    RailNetwork& graph = componentsNetwork();
+    if (graph.blockIndex->empty() && !stations->empty()) graph.blockIndex = BlockIndex(graph);
+    return graph;
+}
+
+ContractedNetwork &RailManager::contraction() {
+    if (contracted.size() == 0 && !stations->empty()) contracted = ContractedNetwork(network());
+    return contracted;
+}
+
 void RailManager::clearData() {
-    stations.clear();
-    segments.clear();
+    stations = {};
+    segments = {};
+    incident = {};
+    capacityPolicy = PER_DIRECTION;
+    stationIndex = {};
     railNet = RailNetwork();
+    contracted = ContractedNetwork();
 }
 
 void RailManager::initializeData(const string& datasetPath) {
     clearData();
     initializeStations(CSVReader::read(datasetPath + "stations.csv"));
     initializeSegments(CSVReader::read(datasetPath + "network.csv"));
-    initializeNetwork();
     // string a = "Casa Branca";
     // string b = "Portalegre";
     // cout << railNet.maxFlow(a,b) << endl;
 }
 
+void RailManager::build() {
+    blockIndexedNetwork();
+    contraction();
+}
+
+// []===========================================[] //
+// ||                 DATASETS                  || //
+// []===========================================[] //
+
+void RailManager::park() {
+    if (!active.empty() || !stations->empty())
+        parked.insert_or_assign(active, Dataset{std::move(stations), std::move(segments), std::move(incident), capacityPolicy, std::move(stationIndex), std::move(railNet), std::move(contracted)});
+    clearData();
+}
+
+void RailManager::loadDataset(const string &name, const string &datasetPath) {
+    park();
+    parked.erase(name);
+    active = name;
+    initializeData(datasetPath);
+}
+
+bool RailManager::useDataset(const string &name) {
+    if (name == active) return true;
+    auto it = parked.find(name);
+    if (it == parked.end()) return false;
+    Dataset dataset = std::move(it->second);
+    parked.erase(it);
+    park();
+    stations = std::move(dataset.stations);
+    segments = std::move(dataset.segments);
+    incident = std::move(dataset.incident);
+    capacityPolicy = dataset.capacityPolicy;
+    stationIndex = std::move(dataset.stationIndex);
+    railNet = std::move(dataset.railNet);
+    contracted = std::move(dataset.contracted);
+    active = name;
+    return true;
+}
+
+bool RailManager::copyDataset(const string &name, const string &copy) {
+    if (name == copy || copy == active) return false;
+    if (name == active) {
+        parked.insert_or_assign(copy, Dataset{stations, segments, incident, capacityPolicy, stationIndex, railNet, contracted});
+        return true;
+    }
+    auto it = parked.find(name);
+    if (it == parked.end()) return false;
+    Dataset dataset = it->second;
+    parked.insert_or_assign(copy, std::move(dataset));
+    return true;
+}
+
+bool RailManager::dropDataset(const string &name) {
+    return name != active && parked.erase(name) > 0;
+}
+
+const string &RailManager::activeDataset() const {
+    return active;
+}
+
+vector<string> RailManager::datasets() const {
+    vector<string> res;
+    for (const auto& [name, _] : parked)
+        res.push_back(name);
+    if (!active.empty() || !stations->empty()) res.push_back(active);
+    sort(res.begin(), res.end());
+    return res;
+}
+
+void RailManager::forEachDataset(const function<void(const string&)>& query) {
+    const string original = active;
+    auto restore = [this, &original]() {
+        if (useDataset(original)) return;
+        park(); // The original was empty, and so wasn't parked
+        active = original;
+    };
+    try {
+        for (const string& name : datasets()) {
+            useDataset(name);
+            query(name);
+        }
+    } catch (...) {
+        restore();
+        throw;
+    }
+    restore();
+}
+
 bool RailManager::segmentExists(const string &origin, const string &destination) {
-    return (segments.find(origin) != segments.end()) && (segments.at(origin).find(destination) != segments.at(origin).end());
+    return findSegment(origin, destination) != UINT_MAX;
 }
 
 bool RailManager::stationExists(const string &station) {
-    return stations.find(station) != stations.end();
+    return stations->find(station) != stations->end();
 }
 
-void RailManager::reactivateAllStations() {
-    for (auto& [_, node] : railNet.nodes)
-        node.active = true;
+unsigned RailManager::maxFlow(const string &origin, const string &destination) {
+    if (!componentsNetwork().components->connected(origin, destination)) return 0;
+    return contraction().maxFlow(origin, destination);
 }
 
-void RailManager::reactivateAllSegments() {
-    for (auto& [_, node] : railNet.nodes)
-        for (auto& edge : node.adj)
-            edge.active = true;
+pair<unsigned, MinCut> RailManager::maxFlowCut(const string &origin, const string &destination) {
+    return contraction().maxFlowCut(origin, destination);
 }
 
-void RailManager::deactivateStations(const list<string> &stationsToDeactivate) {
-    for (const string& station : stationsToDeactivate)
-        railNet.getNode(station).active = false;
+pair<list<pair<string, string>>, unsigned> RailManager::importantStations(const Cancellation& control) {
+    return componentsNetwork().importantStations(control);
 }
 
-void RailManager::deactivateSegments(const list<pair<string, string>> &segmentsToDeactivate) {
-    for (const auto& [stationA, stationB] : segmentsToDeactivate)
-        railNet.getEdge(stationA, stationB).active = false;
+list<pair<string, unsigned>> RailManager::topMunicipalities(int k, const Cancellation& control) {
+    return topK(MUNICIPALITY, k, control);
 }
 
-unsigned RailManager::maxFlow(const string &origin, const string &destination) {
-    return railNet.maxFlow(origin, destination);
+list<pair<string, unsigned>> RailManager::topDistricts(int k, const Cancellation& control) {
+    return topK(DISTRICT, k, control);
 }
 
-pair<list<pair<string, string>>, unsigned> RailManager::importantStations() {
-    return railNet.importantStations();
+list<pair<string, unsigned>> RailManager::topK(StationAttribute attribute, int k, const Cancellation& control) {
+    return network().topGroups(k, *stationIndex, attribute, control);
 }
 
-list<pair<string, unsigned>> RailManager::topMunicipalities(int k) {
-    return railNet.topMunicipalities(k, stations);
+vector<LineReport> RailManager::lineReports() {
+    return network().lineReports(*stationIndex);
 }
 
-list<pair<string, unsigned>> RailManager::topDistricts(int k) {
-    return railNet.topDistricts(k, stations);
+list<pair<Segment, unsigned>> RailManager::rankUpgrades(const list<pair<string, string>> &pairs, unsigned extra, int k) {
+    return network().rankUpgrades(pairs, extra, k);
 }
 
 unsigned RailManager::maxFlowStation(const string &station) {
-    return railNet.maxFlowStation(station);
+    return network().maxFlowStation(station);
 }
 
-unsigned RailManager::maxFlowMinCost(const string &origin, const string &destination) {
-    return railNet.maxFlowMinCost(origin, destination);
+FlowBounds RailManager::maxFlowApprox(const string &origin, const string &destination, unsigned phases) {
+    return network().maxFlowApprox(origin, destination, phases);
 }
 
-unsigned RailManager::maxFlowReduced(const string &origin, const string &destination, const list<pair<string, string>>& segmentsToDeactivate, const list<string>& stationsToDeactivate) {
-    reactivateAllStations();
-    reactivateAllSegments();
-    deactivateSegments(segmentsToDeactivate);
-    deactivateStations(stationsToDeactivate);
-    return railNet.maxFlowReduced(origin, destination);
+FlowBounds RailManager::maxFlowStationApprox(const string &station, unsigned phases) {
+    return network().maxFlowStationApprox(station, phases);
 }
 
-list<pair<string, unsigned>> RailManager::topAffectedStations(int k, const list<pair<string, string>> &segmentsToDeactivate,const list<string> &stationsToDeactivate) {
-    reactivateAllStations();
-    reactivateAllSegments();
-    deactivateSegments(segmentsToDeactivate);
-    deactivateStations(stationsToDeactivate);
-    return railNet.topAffectedStations(k,stations);
+list<pair<string, unsigned>> RailManager::stationsFlowReport(const function<void(const string&, unsigned)>& onResult) {
+    return network().stationsFlowReport(onResult);
 }
 
+unsigned RailManager::maxFlowMinCost(const string &origin, const string &destination, unsigned long long* paths) {
+    return componentsNetwork().maxFlowMinCost(origin, destination, paths);
+}
+
+unsigned RailManager::maxFlowReduced(const string &origin, const string &destination, const Scenario& scenario) {
+    if (blockIndexedNetwork().blockIndex->separated(origin, destination, scenario)) return 0;
+    return contraction().maxFlowReduced(origin, destination, scenario);
+}
+
+pair<unsigned, MinCut> RailManager::maxFlowReducedCut(const string &origin, const string &destination, const Scenario& scenario) {
+    return contraction().maxFlowReducedCut(origin, destination, scenario);
+}
 
+vector<unsigned> RailManager::maxFlowScenarios(const string &origin, const string &destination, const vector<Scenario> &scenarios) {
+    return componentsNetwork().maxFlowScenarios(origin, destination, scenarios);
+}
+
+list<pair<string, unsigned>> RailManager::topAffectedStations(int k, const Scenario& scenario, const Cancellation& control) {
+    return blockIndexedNetwork().topAffectedStations(k, *stations, scenario, control);
+}
+
+ReliabilityReport RailManager::simulateFailures(const string &origin, const string &destination, const FailureModel &model, unsigned long long samples, unsigned seed) {
+    return blockIndexedNetwork().simulateFailures(origin, destination, model, samples, seed);
+}
 
+// []===========================================[] //
+// ||                   EDITS                   || //
+// []===========================================[] //
+
+// Every edit keeps the graph, its contraction and the component index up to date incrementally, if they were built.
+// Edits that change which stations are connected by segments drop the block index instead, to be built again on its
+// next use, as its blocks can merge or split far from the edit.
+
+bool RailManager::insertStation(const string &name, const string &district, const string &municipality, const string &township, const string &line) {
+    if (stationExists(name)) return false;
+    bool built = !railNet.nodes.empty() || stations->empty();
+    addStation(name, district, municipality, township, line);
+    if (!built) return true;
+    railNet.addNode(name, {});
+    if (contracted.size() > 0) contracted.addStation(name);
+    railNet.components.edit().addStation(name); // The block index doesn't need to know a station without segments
+    return true;
+}
+
+bool RailManager::removeStation(const string &station) {
+    if (!stationExists(station)) return false;
+    if (incident->count(station)) {
+        while (!incident->at(station).empty()) // Looked up again, as erasing can give the incidence lists a copy of their own
+            eraseSegment(incident->at(station).back());
+        incident.edit().erase(station);
+    }
+    stationIndex.edit().remove(stations->at(station));
+    stations.edit().erase(station);
+    if (railNet.nodes.empty()) return true;
+    railNet.removeNode(station);
+    if (contracted.size() > 0) contracted.removeStation(station);
+    railNet.components.edit().removeStation(station);
+    railNet.blockIndex = {};
+    return true;
+}
+
+bool RailManager::insertSegment(const string &stationA, const string &stationB, unsigned capacity, SegmentType service) {
+    if (!stationExists(stationA) || !stationExists(stationB) || stationA == stationB || service == INVALID) return false;
+    if (segmentExists(stationA, stationB)) return false;
+    addSegment(stationA, stationB, capacity, service);
+    if (railNet.nodes.empty()) return true;
+    railNet.addEdge(stationA, RailNetwork::Edge(railNet.intern(stationB), service, capacity));
+    railNet.addEdge(stationB, RailNetwork::Edge(railNet.intern(stationA), service, capacity));
+    if (contracted.size() > 0) contracted.addSegment(stationA, stationB, capacity, service);
+    railNet.components.edit().addSegment(stationA, stationB);
+    railNet.blockIndex = {};
+    return true;
+}
+
+bool RailManager::removeSegment(const string &stationA, const string &stationB) {
+    if (!stationExists(stationA) || !stationExists(stationB) || !segmentExists(stationA, stationB)) return false;
+    eraseSegment(findSegment(stationA, stationB));
+    if (railNet.nodes.empty()) return true;
+    railNet.removeEdge(stationA, stationB);
+    railNet.removeEdge(stationB, stationA);
+    if (contracted.size() > 0) contracted.removeSegment(stationA, stationB);
+    railNet.components.edit().removeSegment(stationA, stationB);
+    railNet.blockIndex = {};
+    return true;
+}
+
+bool RailManager::setSegmentCapacity(const string &stationA, const string &stationB, unsigned capacity) {
+    if (!stationExists(stationA) || !stationExists(stationB) || !segmentExists(stationA, stationB)) return false;
+    segments.edit()[findSegment(stationA, stationB)].capacity = capacity;
+    for (const auto& [origin, destination] : {make_pair(stationA, stationB), make_pair(stationB, stationA)}) {
+        if (railNet.nodes.empty()) continue;
+        railNet.getEdge(origin, destination).capacity = capacity;
+        if (contracted.size() > 0) contracted.setCapacity(origin, destination, capacity);
+    }
+    return true; // Connectivity doesn't change, so neither do the indexes
+}
+
+void RailManager::setCapacityPolicy(CapacityPolicy policy) {
+    capacityPolicy = policy;
+    railNet.capacityPolicy = policy;
+    contracted = ContractedNetwork();
+}
+
+CapacityPolicy RailManager::getCapacityPolicy() const {
+    return capacityPolicy;
+}
+
+bool RailManager::exportImage(const string &path) {
+    return NetworkImage::write(path, network(), *stations);
+}
@@ -2,24 +2,70 @@
 #ifndef RAILNETWORK_RAILMANAGER_H
 #define RAILNETWORK_RAILMANAGER_H
 
+#include <functional>
 #include <unordered_map>
 #include <string>
+#include <vector>
 
+#include "ContractedNetwork.h"
+#include "CopyOnWrite.h"
 #include "RailNetwork.h"
 #include "CSVReader.h"
+#include "NetworkImage.h"
 #include "Station.h"
+#include "StationIndex.h"
 
 /**
  * @brief A class representing the rail network manager.
  * This class manages a rail network, composed of stations and segments connecting them. It provides various methods
- * to query information about the network, such as maximum flow, top municipalities, top districts, etc. It also
- * provides methods to activate and deactivate stations and segments, allowing for simulating maintenance or damage to
- * the network.
+ * to query information about the network, such as maximum flow, top municipalities, top districts, etc. Queries can
+ * also take a Scenario of stations and segments out of service, allowing for simulating maintenance or damage to the
+ * network without changing it.
+ * Loading only reads the stations and segments. The graph, its indexes and its contraction are built on the first query
+ * that needs each of them, and kept (and updated by edits) afterwards.
+ * Several named datasets can be resident at once. Queries run on the active one, whose data are the members below;
+ * the others are parked, moved out whole, and switching moves them back without copying or rebuilding anything.
  */
 class RailManager {
-    std::unordered_map<std::string, Station> stations;
-    std::unordered_map<std::string, std::unordered_map<std::string, Segment>> segments;
+    /**
+     * @brief A dataset that isn't active, with everything built for it.
+     */
+    struct Dataset {
+        CopyOnWrite<std::unordered_map<std::string, Station>> stations;
+        CopyOnWrite<std::vector<Segment>> segments;
+        CopyOnWrite<std::unordered_map<std::string, std::vector<unsigned>>> incident;
+        CapacityPolicy capacityPolicy;
+        CopyOnWrite<StationIndex> stationIndex;
+        RailNetwork railNet;
+        ContractedNetwork contracted;
+    };
+    // The stations, the segments and the station index are shared by the copies of a dataset (and of the manager) until
+    // either is edited
+    CopyOnWrite<std::unordered_map<std::string, Station>> stations;
+    CopyOnWrite<std::vector<Segment>> segments; // One per physical segment, in the direction it was loaded
+    CopyOnWrite<std::unordered_map<std::string, std::vector<unsigned>>> incident; // Of each station: the segments it's an end of
+    CapacityPolicy capacityPolicy = PER_DIRECTION;
+    CopyOnWrite<StationIndex> stationIndex; // The stations of each district, municipality, township and line
     RailNetwork railNet;
+    ContractedNetwork contracted; // Answers the point-to-point flow queries
+    std::string active; // The name of the active dataset
+    std::unordered_map<std::string, Dataset> parked; // The other resident datasets, by name
+    /**
+     * @brief Moves the active dataset out of the members and parks it under its name, unless it's empty.
+     */
+    void park();
+    /**
+     * @brief Finds the segment between two stations, whichever direction it was loaded in.
+     * @param stationA The name of a station.
+     * @param stationB The name of the other station.
+     * @return The id of the segment, or UINT_MAX if there is none.
+     */
+    unsigned findSegment(const std::string& stationA, const std::string& stationB) const;
+    /**
+     * @brief Removes a segment from the segments and the incidence lists of its stations. The last segment takes its id.
+     * @param id The id of the segment.
+     */
+    void eraseSegment(unsigned id);
     /**
      * @brief Add a new segment to the network.
      * This method adds a new segment to the network connecting two stations, with a given capacity and service type.
@@ -53,9 +99,31 @@ class RailManager {
     void initializeSegments(const CSV& networkCSV);
     /**
      * @brief Initialize the network graph.
-     * This method initializes the rail network object that represents the network as a graph.
+     * This method initializes the rail network object that represents the network as a graph. Its indexes and its
+     * contracted version are left for their first use.
      */
     void initializeNetwork();
+    /**
+     * @brief Gets the network graph, building it on first use.
+     * @return The graph.
+     */
+    RailNetwork& network();
+    /**
+     * @brief Gets the network graph with its component index, building them on first use.
+     * @return The graph.
+     */
+    RailNetwork& componentsNetwork();
+    /**
+     * @brief Gets the network graph with its component and block indexes, building them on first use. Only
+     * maxFlowReduced, topAffectedStations and simulateFailures build the block index.
+     * @return The graph.
+     */
+    RailNetwork& blockIndexedNetwork();
+    /**
+     * @brief Gets the contracted network, building it on first use.
+     * @return The contracted network.
+     */
+    ContractedNetwork& contraction();
     /**
      * @brief Clear all data in the network.
      * This method clears all data in the network, including stations and segments.
@@ -80,12 +148,61 @@ public:
      */
     void initializeData(const std::string& datasetPath);
     /**
-     * @brief Gets the segment between two stations.
+     * @brief Builds the graph, its indexes and its contraction now instead of on first use, e.g. before the manager is
+     * copied, so the copies share the indexes instead of each building its own.
+     */
+    void build();
+    /**
+     * @brief Loads a dataset under a name and makes it the active one. The dataset that was active stays resident.
+     * @param name The name of the dataset. A resident dataset with the same name is replaced.
+     * @param datasetPath The path to the directory containing the CSV files.
+     */
+    void loadDataset(const std::string& name, const std::string& datasetPath);
+    /**
+     * @brief Makes a resident dataset the active one, in O(1).
+     * @param name The name of the dataset.
+     * @return False if no dataset with that name is resident.
+     */
+    bool useDataset(const std::string& name);
+    /**
+     * @brief Copies a resident dataset under another name, e.g. to edit a proposal while keeping its baseline.
+     * The active dataset doesn't change. The copies share their stations until either of them is edited.
+     * @param name The name of the dataset to copy.
+     * @param copy The name of the copy. A resident dataset with the same name is replaced.
+     * @return False if no dataset with that name is resident or the names are the same.
+     */
+    bool copyDataset(const std::string& name, const std::string& copy);
+    /**
+     * @brief Drops a resident dataset that isn't the active one.
+     * @param name The name of the dataset.
+     * @return False if no such dataset is resident.
+     */
+    bool dropDataset(const std::string& name);
+    /**
+     * @brief Gets the name of the active dataset.
+     * @return The name, empty if it was loaded by initializeData.
+     */
+    const std::string& activeDataset() const;
+    /**
+     * @brief Gets the names of the resident datasets, the active one included if it isn't empty.
+     * @return The names, sorted.
+     */
+    std::vector<std::string> datasets() const;
+    /**
+     * @brief Runs a query on every resident dataset in turn, for side-by-side comparison. Each dataset is made active
+     * while its query runs, and the dataset that was active is active again afterwards.
+     * @param query Called with the name of each dataset, in order, while it's active.
+     */
+    void forEachDataset(const std::function<void(const std::string&)>& query);
+    /**
+     * @brief Gets the segment between two stations. Each segment is stored once, in the direction it was loaded, and
+     * returned in the direction asked for.
      * @param origin The name of the origin station.
      * @param destination The name of the destination station.
-     * @return The segment object between the two stations.
+     * @return A copy of the segment, from origin to destination.
+     * @throws std::out_of_range If there is no segment between them.
      */
-    const Segment& getSegment(const std::string& origin, const std::string& destination);
+    Segment getSegment(const std::string& origin, const std::string& destination);
     /**
      * @brief Gets the station with the given name.
      * @param station The name of the station.
@@ -99,53 +216,135 @@ public:
      * @return The maximum flow between the two stations.
      */
     unsigned maxFlow(const std::string& origin, const std::string& destination);
+    /**
+     * @brief Calculates the maximum flow between two stations and the minimum cut that limits it.
+     * @param origin The name of the origin station.
+     * @param destination The name of the destination station.
+     * @return A pair of the maximum flow and its minimum cut.
+     */
+    std::pair<unsigned, MinCut> maxFlowCut(const std::string& origin, const std::string& destination);
     /**
      * @brief Gets a list of the most important stations in the network and the maximum number of trains between them.
+     * @param control Stops the search early (the result is then partial) and receives its progress.
      * @return A pair of the list of pairs of station names and their corresponding the maxFlow.
      */
-    std::pair<std::list<std::pair<std::string, std::string>>, unsigned> importantStations();
+    std::pair<std::list<std::pair<std::string, std::string>>, unsigned> importantStations(const Cancellation& control = Cancellation::none());
     /**
      * @brief Gets a list of the top k municipalities in the network, ranked by the number of stations they contain.
      * @param k The number of municipalities to include in the list.
+     * @param control Stops the search early (the result is then partial) and receives its progress.
      * @return A list of the names of the top k municipalities.
      */
-    std::list<std::pair<std::string, unsigned>> topMunicipalities(int k);
+    std::list<std::pair<std::string, unsigned>> topMunicipalities(int k, const Cancellation& control = Cancellation::none());
     /**
      * @brief Gets the top k districts with the most stations.
      * @param k The number of top districts to return.
+     * @param control Stops the search early (the result is then partial) and receives its progress.
      * @return A list of the names of the top k districts.
      */
-    std::list<std::pair<std::string, unsigned>> topDistricts(int k);
+    std::list<std::pair<std::string, unsigned>> topDistricts(int k, const Cancellation& control = Cancellation::none());
+    /**
+     * @brief Gets the top k values of a station attribute (district, municipality, township or line), ranked by the
+     * maximum flow between any two of their stations using only the segments between them.
+     * @param attribute The attribute the stations are grouped by.
+     * @param k The number of values to return.
+     * @param control Stops the search early (the result is then partial) and receives its progress.
+     * @return A list of the top k values and their flows.
+     */
+    std::list<std::pair<std::string, unsigned>> topK(StationAttribute attribute, int k, const Cancellation& control = Cancellation::none());
+    /**
+     * @brief Gets, for every railway line, the maximum flow between its terminals along its own segments, the segments
+     * that limit it, and the capacity to change to other lines at each of its junction stations.
+     * @return The report of each line, sorted by line name.
+     */
+    std::vector<LineReport> lineReports();
+    /**
+     * @brief Ranks the segments by how much an upgrade of each would raise the maximum flow between some pairs of
+     * stations, summed over the pairs.
+     * @param pairs The origin and destination of each pair.
+     * @param extra The capacity an upgrade adds to a segment, both ways.
+     * @param k The number of segments to return.
+     * @return The k segments with the largest gains, and their gains. Segments that add no flow aren't returned.
+     */
+    std::list<std::pair<Segment, unsigned>> rankUpgrades(const std::list<std::pair<std::string, std::string>>& pairs, unsigned extra, int k);
     /**
      * @brief Computes the maximum flow that can pass through a given station.
      * @param station The name of the station.
      * @return The maximum flow that can pass through the given station.
      */
     unsigned maxFlowStation(const std::string& station);
+    /**
+     * @brief Estimates the maximum flow between two stations, for when a fast answer matters more than an exact one.
+     * @param origin The name of the origin station.
+     * @param destination The name of the destination station.
+     * @param phases The number of capacity scaling phases (more phases give tighter bounds).
+     * @return A lower bound (a flow that can run) and an upper bound (the capacity of a cut) of the maximum flow.
+     */
+    FlowBounds maxFlowApprox(const std::string& origin, const std::string& destination, unsigned phases = 2);
+    /**
+     * @brief Estimates the maximum flow that can pass through a given station.
+     * @param station The name of the station.
+     * @param phases The number of capacity scaling phases (more phases give tighter bounds).
+     * @return A lower bound (a flow that can run) and an upper bound (the capacity of a cut) of the maximum flow.
+     */
+    FlowBounds maxFlowStationApprox(const std::string& station, unsigned phases = 2);
+    /**
+     * @brief Computes the maximum flow that can pass through every station, ranked by flow.
+     * @param onResult Called with each station and its flow as soon as it is computed.
+     * @return A list of all stations and their maximum flow, ranked by flow.
+     */
+    std::list<std::pair<std::string, unsigned>> stationsFlowReport(const std::function<void(const std::string&, unsigned)>& onResult = nullptr);
     /**
      * @brief Computes the maximum flow between two stations with minimum cost.
      * @param origin The name of the origin station.
      * @param destination The name of the destination station.
+     * @param paths If not null, set to the number of paths with minimum cost between them.
      * @return The maximum flow that can pass through the two stations with minimum cost.
      */
-    unsigned maxFlowMinCost(const std::string& origin, const std::string& destination);
+    unsigned maxFlowMinCost(const std::string& origin, const std::string& destination, unsigned long long* paths = nullptr);
     /**
      * @brief Computes the maximum flow between two stations with some segments and/or stations deactivated.
      * @param origin The name of the origin station.
      * @param destination The name of the destination station.
-     * @param segmentsToDeactivate A list of pairs of stations that represent the segments to deactivate.
-     * @param stationsToDeactivate A list of names of stations to deactivate.
+     * @param scenario The segments and stations deactivated.
      * @return The maximum flow that can pass through the two stations with the given segments and/or stations deactivated.
      */
-    unsigned maxFlowReduced(const std::string& origin, const std::string& destination, const std::list<std::pair<std::string, std::string>>& segmentsToDeactivate, const std::list<std::string>& stationsToDeactivate);
+    unsigned maxFlowReduced(const std::string& origin, const std::string& destination, const Scenario& scenario);
+    /**
+     * @brief Computes the maximum flow between two stations with some segments and/or stations deactivated, and the
+     * minimum cut that limits it.
+     * @param origin The name of the origin station.
+     * @param destination The name of the destination station.
+     * @param scenario The segments and stations deactivated.
+     * @return A pair of the maximum flow and its minimum cut.
+     */
+    std::pair<unsigned, MinCut> maxFlowReducedCut(const std::string& origin, const std::string& destination, const Scenario& scenario);
+    /**
+     * @brief Computes the maximum flow between two stations under each of the given scenarios, concurrently.
+     * @param origin The name of the origin station.
+     * @param destination The name of the destination station.
+     * @param scenarios The scenarios to evaluate.
+     * @return The maximum flow under each scenario, in the same order.
+     */
+    std::vector<unsigned> maxFlowScenarios(const std::string& origin, const std::string& destination, const std::vector<Scenario>& scenarios);
     /**
      * @brief Gets the top k stations that are most affected by the given segments and/or stations being deactivated.
      * @param k The number of top affected stations to return.
-     * @param segmentsToDeactivate A list of pairs of stations that represent the segments to deactivate.
-     * @param stationsToDeactivate A list of names of stations to deactivate.
+     * @param scenario The segments and stations deactivated.
+     * @param control Stops the search early (the result is then partial) and receives its progress.
      * @return A list of the names of the top k stations that are most affected by the given segments and/or stations being deactivated.
      */
-    std::list<std::pair<std::string, unsigned>> topAffectedStations(int k,const std::list<std::pair<std::string, std::string>>& segmentsToDeactivate, const std::list<std::string>& stationsToDeactivate);
+    std::list<std::pair<std::string, unsigned>> topAffectedStations(int k, const Scenario& scenario, const Cancellation& control = Cancellation::none());
+    /**
+     * @brief Simulates random segment and station failures and gets the distribution of the maximum flow between two stations.
+     * @param origin The name of the origin station.
+     * @param destination The name of the destination station.
+     * @param model The failure probability of each segment and station.
+     * @param samples The number of failure scenarios to sample.
+     * @param seed The seed of the random number generators.
+     * @return The distribution of the maximum flow between the two stations over all samples.
+     */
+    ReliabilityReport simulateFailures(const std::string& origin, const std::string& destination, const FailureModel& model, unsigned long long samples, unsigned seed = 0);
     /**
      * @brief Checks if a segment exists between two stations.
      * @param origin The name of the origin station.
@@ -160,25 +359,65 @@ public:
      */
     bool stationExists(const std::string& station);
     /**
-     * @brief Reactivates all stations that have been deactivated.
+     * @brief Adds a station, without segments, to the loaded network.
+     * @param name The name of the new station.
+     * @param district The district where the new station is located.
+     * @param municipality The municipality where the new station is located.
+     * @param township The township where the new station is located.
+     * @param line The line to which the new station belongs.
+     * @return False if a station with that name already exists.
+     */
+    bool insertStation(const std::string& name, const std::string& district, const std::string& municipality, const std::string& township, const std::string& line);
+    /**
+     * @brief Removes a station and every segment to or from it from the loaded network.
+     * @param station The name of the station.
+     * @return False if the station doesn't exist.
+     */
+    bool removeStation(const std::string& station);
+    /**
+     * @brief Adds a segment, both ways, between two stations of the loaded network.
+     * @param stationA The name of the first station.
+     * @param stationB The name of the second station.
+     * @param capacity The capacity of the new segment.
+     * @param service The service type of the new segment.
+     * @return False if a station doesn't exist, they are the same, they already have a segment or the service is invalid.
+     */
+    bool insertSegment(const std::string& stationA, const std::string& stationB, unsigned capacity, SegmentType service);
+    /**
+     * @brief Removes the segment between two stations, both ways, from the loaded network.
+     * @param stationA The name of the first station.
+     * @param stationB The name of the second station.
+     * @return False if there is no segment between them.
+     */
+    bool removeSegment(const std::string& stationA, const std::string& stationB);
+    /**
+     * @brief Changes the capacity of the segment between two stations, both ways.
+     * @param stationA The name of the first station.
+     * @param stationB The name of the second station.
+     * @param capacity The new capacity.
+     * @return False if there is no segment between them.
      */
-    void reactivateAllStations();
+    bool setSegmentCapacity(const std::string& stationA, const std::string& stationB, unsigned capacity);
     /**
-     * @brief Reactivates all segments that have been deactivated.
+     * @brief Chooses whether the two directions of every segment get its full capacity or share it. The contraction is
+     * dropped, to be built again with the new policy on its next use.
+     * @param policy The capacity policy.
      */
-    void reactivateAllSegments();
+    void setCapacityPolicy(CapacityPolicy policy);
     /**
-     * @brief Deactivates the given list of stations.
-     * @param stations A list of names of stations to deactivate.
+     * @brief Gets the capacity policy of the active dataset.
+     * @return The capacity policy.
      */
-    void deactivateStations(const std::list<std::string>& stations);
+    CapacityPolicy getCapacityPolicy() const;
     /**
-     * @brief Deactivates the given list of segments.
-     * @param segments A list of pairs of stations that represent the segments to deactivate.
+     * @brief Writes the network of the active dataset as an image that other processes can attach to (see NetworkImage).
+     * @param path The path of the image file.
+     * @return False if the file couldn't be written.
      */
-    void deactivateSegments(const std::list<std::pair<std::string, std::string>>& segments);
+    bool exportImage(const std::string& path);
 
     friend class App;
+    friend class Checks;
 };
 
 
@@ -1,13 +1,23 @@
 
 #include <stdexcept>
+#include <climits>
 #include <unordered_set>
 #include <set>
 #include <queue>
 #include <algorithm>
 #include <iostream>
+#include <map>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <tuple>
 
 #include "RailNetwork.h"
 #include "Segment.h"
+#include "Parallel.h"
+#include "PathSearch.h"
 
 using namespace std;
 
@@ -36,74 +46,187 @@ RailNetwork::Node& RailNetwork::getNode(const string &station) {
     return nodes.at(station);
 }
 
+const string* RailNetwork::intern(const string &name) {
+    auto it = names.find(name);
+    if (it == names.end()) {
+        auto owned = make_shared<const string>(name);
+        string_view key = *owned;
+        it = names.emplace(key, std::move(owned)).first;
+    }
+    return it->second.get();
+}
+
 void RailNetwork::addNode(const std::string& name, const std::list<Edge>& adj) {
-    nodes.insert({name, Node(name, adj)});
+    auto it = nodes.insert({name, Node(name, adj)}).first;
+    for (Edge& edge : it->second.adj) {
+        edge.dest = intern(*edge.dest); // May point to another network's names
+        edge.flowStamp = edge.dagStamp = 0; // Flows of another network's epochs
+        edge.to = nullptr;
+        edge.twin = nullptr;
+    }
+    twinsLinked = false;
+    layout.reset();
+}
+
+RailNetwork::RailNetwork(const RailNetwork& other) :
+    nodes(other.nodes),
+    names(other.names),
+    visitEpoch(other.visitEpoch),
+    prevEpoch(other.prevEpoch),
+    costEpoch(other.costEpoch),
+    flowEpoch(other.flowEpoch),
+    dagEpoch(other.dagEpoch),
+    capacityPolicy(other.capacityPolicy),
+    blockIndex(other.blockIndex),
+    components(other.components) {
+    unlink();
+}
+
+RailNetwork& RailNetwork::operator=(const RailNetwork& other) {
+    if (this != &other) *this = RailNetwork(other);
+    return *this;
+}
+
+RailNetwork::Node& RailNetwork::target(Edge& edge) {
+    if (edge.to == nullptr) edge.to = &getNode(*edge.dest);
+    return *edge.to;
+}
+
+void RailNetwork::unlink() {
+    for (auto& [_, node] : nodes)
+        for (Edge& edge : node.adj) {
+            edge.to = nullptr;
+            edge.twin = nullptr;
+        }
+    twinsLinked = false;
+    clearPrevs();
 }
 
 RailNetwork::Edge& RailNetwork::getEdge(const std::string& src, const string &dest) {
     for (Edge& edge : getNode(src).adj)
-        if (edge.dest == dest)
+        if (*edge.dest == dest)
             return edge;
     throw std::out_of_range("Didn't Find the Edge.");
 }
 
 void RailNetwork::visit(const std::string& station, SegmentType type){
-    switch (type) {
-        case INVALID: getNode(station).visited = true; break;
-        case STANDARD: getNode(station).visitedStandard = true; break;
-        case ALFA_PENDULAR: getNode(station).visitedAlfa = true; break;
-    }
+    getNode(station).visitedStamp[type] = visitEpoch;
 }
 
 bool RailNetwork::isVisited(const std::string& station, SegmentType type){
-    switch (type) {
-        case INVALID: return nodes.at(station).visited;
-        case STANDARD: return nodes.at(station).visitedStandard;
-        case ALFA_PENDULAR: return nodes.at(station).visitedAlfa;
-    }
+    return isVisited(nodes.at(station), type);
 }
 
+bool RailNetwork::isVisited(const Node& node, SegmentType type) const {
+    return node.visitedStamp[type] == visitEpoch;
+}
+
+// Epochs only wrap around after ~4 billion clears, the only time stamps are actually reset.
 void RailNetwork::clearVisits() {
-    for(auto& p : nodes) {
-        p.second.visited = false;
-        p.second.visitedStandard = false;
-        p.second.visitedAlfa = false;
-    }
+    if (++visitEpoch != 0) return;
+    for (auto& [_,node] : nodes)
+        fill(begin(node.visitedStamp), end(node.visitedStamp), 0);
+    visitEpoch = 1;
 }
 
 void RailNetwork::clearPrevs() {
-    for(auto& p : nodes) {
-        p.second.prev = "";
-        p.second.prevStandard = "";
-        p.second.prevAlfa = "";
-    }
+    if (++prevEpoch != 0) return;
+    for (auto& [_,node] : nodes)
+        fill(begin(node.prevStamp), end(node.prevStamp), 0);
+    prevEpoch = 1;
 }
 
 void RailNetwork::clearFlow() {
-    for(auto& [_,node] : nodes)
-        for(Edge& e : node.adj)
-            e.flow = 0;
+    if (++flowEpoch != 0) return;
+    for (auto& [_,node] : nodes)
+        for (Edge& e : node.adj)
+            e.flowStamp = 0;
+    flowEpoch = 1;
 }
 
 void RailNetwork::clearCost() {
-    for(auto& [_,node] : nodes)
-        node.cost = UINT_MAX;
+    if (++costEpoch != 0) return;
+    for (auto& [_,node] : nodes)
+        node.costStamp = 0;
+    costEpoch = 1;
+}
+
+void RailNetwork::clearDAG() {
+    if (++dagEpoch != 0) return;
+    for (auto& [_,node] : nodes)
+        for (Edge& e : node.adj)
+            e.dagStamp = 0;
+    dagEpoch = 1;
+}
+
+bool RailNetwork::inDAG(const Edge& edge) const {
+    return edge.dagStamp == dagEpoch;
+}
+
+unsigned RailNetwork::getFlow(const Edge& edge) const {
+    return edge.flowStamp == flowEpoch ? edge.flow : 0;
+}
+
+void RailNetwork::addFlow(Edge& edge, unsigned flow) {
+    if (edge.flowStamp != flowEpoch) {
+        edge.flow = 0;
+        edge.flowStamp = flowEpoch;
+    }
+    edge.flow += flow;
+    if (capacityPolicy != SHARED) return;
+    if (!twinsLinked) linkTwins();
+    Edge* twin = edge.twin;
+    if (twin == nullptr) return;
+    if (twin->flowStamp != flowEpoch) {
+        twin->flow = 0;
+        twin->flowStamp = flowEpoch;
+    }
+    twin->flow += flow;
+}
+
+void RailNetwork::subtractFlow(Edge& edge, unsigned flow) {
+    if (getFlow(edge) < flow) throw logic_error("Taking more flow out of an edge than it carries.");
+    edge.flow -= flow;
+    if (capacityPolicy != SHARED) return;
+    if (!twinsLinked) linkTwins();
+    if (edge.twin != nullptr) edge.twin->flow -= flow; // Charged with the same flow by addFlow
+}
+
+void RailNetwork::linkTwins() {
+    for (auto& [_, node] : nodes)
+        for (Edge& edge : node.adj)
+            edge.twin = nullptr;
+    for (auto& [name, node] : nodes)
+        for (Edge& edge : node.adj) {
+            if (edge.twin != nullptr) continue;
+            for (Edge& back : target(edge).adj)
+                if (back.twin == nullptr && *back.dest == name && &back != &edge) {
+                    edge.twin = &back;
+                    back.twin = &edge;
+                    break;
+                }
+        }
+    twinsLinked = true;
 }
 
 void RailNetwork::setCost(const string& node, unsigned cost) {
-    nodes.at(node).cost = cost;
+    Node& n = nodes.at(node);
+    n.cost = cost;
+    n.costStamp = costEpoch;
 }
 
 unsigned RailNetwork::getCost(const string& node) {
-    return nodes.at(node).cost;
+    const Node& n = nodes.at(node);
+    return n.costStamp == costEpoch ? n.cost : UINT_MAX;
 }
 
-void RailNetwork::setPrev(const string &node, const string &prev, SegmentType type) {
-    switch (type) {
-        case INVALID: getNode(node).prev = prev; break;
-        case STANDARD: getNode(node).prevStandard = prev; break;
-        case ALFA_PENDULAR: getNode(node).prevAlfa = prev; break;
-    }
+void RailNetwork::setPrev(Node& node, Node& prev, Edge& edge, SegmentType type) {
+    node.prev[type] = {&prev, &edge};
+    node.prevStamp[type] = prevEpoch;
+}
+
+pair<RailNetwork::Node*, RailNetwork::Edge*> RailNetwork::getPrev(const Node& node, SegmentType type) const {
+    return node.prevStamp[type] == prevEpoch ? node.prev[type] : pair<Node*, Edge*>(nullptr, nullptr);
 }
 
 list<RailNetwork::Edge> RailNetwork::getAdj(const string &station) {
@@ -111,7 +234,34 @@ list<RailNetwork::Edge> RailNetwork::getAdj(const string &station) {
 }
 
 void RailNetwork::addEdge(const string &node, const Edge &edge) {
-    getNode(node).adj.push_back(edge);
+    Node& n = getNode(node);
+    n.adj.push_back(edge);
+    n.adj.back().dest = intern(*edge.dest);
+    n.adj.back().flowStamp = n.adj.back().dagStamp = 0; // Flow of another network's epochs
+    n.adj.back().to = nullptr;
+    n.adj.back().twin = nullptr;
+    twinsLinked = false;
+    if (node != sourceNodeName) layout.reset(); // The layout leaves the super source out
+}
+
+// Prevs may point to what is removed, so they are dropped
+bool RailNetwork::removeEdge(const string &node, const string &dest) {
+    list<Edge>& adj = getNode(node).adj;
+    size_t before = adj.size();
+    adj.remove_if([&dest](const Edge& edge) { return *edge.dest == dest; });
+    twinsLinked = false;
+    layout.reset();
+    clearPrevs();
+    return adj.size() != before;
+}
+
+void RailNetwork::removeNode(const string &name) {
+    for (auto& [_, node] : nodes) // Edges keep a pointer to the node they lead to
+        node.adj.remove_if([&name](const Edge& edge) { return *edge.dest == name; });
+    nodes.erase(name);
+    twinsLinked = false;
+    layout.reset();
+    clearPrevs();
 }
 
 // []===========================================[] //
@@ -119,48 +269,41 @@ void RailNetwork::addEdge(const string &node, const Edge &edge) {
 // []===========================================[] //
 
 
-list<string> RailNetwork::BFSFlow(const string &src, const string &dest) {
-    clearVisits();
-    clearPrevs();
-    queue<pair<string, SegmentType>> q;
-    q.push({src, INVALID});
-    list<string> res;
-    visit(src);
-    while (!q.empty()) { // No more Nodes
-        auto [curr, type] = q.front();
-        visit(curr, type);
-        list<Edge> edges = getAdj(curr);
-        q.pop();
-        for(const Edge& edge : edges) {
-            if (type != INVALID && (type != edge.type)) continue; // Different Train
-            if (edge.flow == edge.capacity) continue; // if segment flow is full dont add node to queue
-            if (isVisited(edge.dest)) continue;
-            if (isVisited(edge.dest, edge.type)) continue;
-            setPrev(edge.dest, curr, edge.type);
-            q.push({edge.dest, edge.type});
-            if (edge.dest == dest) goto found_destination;
-        }
-    }
-    goto skip_found_destination;
-    found_destination:
-    res.push_front(dest);
-    if (getNode(dest).prevAlfa.empty()){ // Standard
-        while (true) {
-            if (res.front() == src) break;
-            Node& aux = getNode(res.front());
-            string prev = aux.prevStandard.empty() ? aux.prev : aux.prevStandard;
-            res.push_front(prev);
-        }
-    } else { // Alfa
-        while (true) {
-            if (res.front() == src) break;
-            Node& aux = getNode(res.front());
-            string prev = aux.prevAlfa.empty() ? aux.prev : aux.prevAlfa;
-            res.push_front(prev);
-        }
+// The walk typedPath shares with NetworkImage, over the nodes and their adjacency lists
+struct RailNetwork::PathGraph {
+    using Vertex = Node*;
+    using Arc = Edge*;
+    RailNetwork& network;
+    void restart() {
+        network.clearVisits();
+        network.clearPrevs();
     }
-    skip_found_destination:
-    return res;
+    bool visited(Node* node, SegmentType type) const { return network.isVisited(*node, type); }
+    void visit(Node* node, SegmentType type) { node->visitedStamp[type] = network.visitEpoch; }
+    template<class G>
+    void forEachArc(Node* node, G g) {
+        for (Edge& edge : node->adj)
+            if (g(&edge)) return;
+    }
+    SegmentType type(Edge* edge) const { return edge->type; }
+    Node* target(Edge* edge) { return &network.target(*edge); }
+    void setPrev(Node* node, Node* prev, Edge* edge, SegmentType type) { network.setPrev(*node, *prev, *edge, type); }
+    bool getPrev(Node* node, SegmentType type, Node*& prev, Edge*& edge) const {
+        std::tie(prev, edge) = network.getPrev(*node, type);
+        return prev != nullptr;
+    }
+};
+
+template<class F>
+vector<RailNetwork::Edge*> RailNetwork::BFSPath(const string &src, const string &dest, F usable) {
+    PathGraph graph{*this};
+    return typedPath(graph, &getNode(src), &getNode(dest), [&usable](Node* from, Edge* edge) { return usable(*from, *edge); });
+}
+
+vector<RailNetwork::Edge*> RailNetwork::BFSFlow(const string &src, const string &dest, unsigned minResidual) {
+    return BFSPath(src, dest, [this, minResidual](const Node&, const Edge& edge) {
+        return edge.capacity - getFlow(edge) >= minResidual; // if segment flow is full dont add node to queue
+    });
 }
 
 static unsigned getCostByType(SegmentType type){
@@ -174,236 +317,711 @@ static unsigned getCostByType(SegmentType type){
     }
 }
 
-list<list<string>> RailNetwork::BFSCost(const string &src, const string &dest) {
+vector<RailNetwork::Node*> RailNetwork::minCostDAG(const string &src, const string &dest, unsigned long long* paths) {
     clearCost();
-    priority_queue<pair<pair<list<string>, SegmentType>, unsigned>, vector<pair<pair<list<string>, SegmentType>, unsigned>>, GreaterCompare<pair<list<string>, SegmentType>>> q;
-    q.push({{{src}, INVALID}, 0});
-    setCost(src, 0);
-    list<list<string>> res;
-    unsigned minCost = UINT_MAX;
-    while (!q.empty()) { // No more Nodes
-        auto [p, cost] = q.top();
-        auto [curr, type] = p;
+    clearDAG();
+    if (paths != nullptr) *paths = 0;
+    auto cost = [this](const Node& node) { return node.costStamp == costEpoch ? node.cost : UINT_MAX; };
+    Node& source = getNode(src);
+    Node& target = getNode(dest);
+    // Every edge that reaches a node with its minimum cost, i.e. the last edge of a minimum cost path to it
+    unordered_map<Node*, vector<pair<Node*, Edge*>>> tight;
+    vector<Node*> settled;
+    priority_queue<pair<unsigned, Node*>, vector<pair<unsigned, Node*>>, greater<pair<unsigned, Node*>>> q;
+    source.cost = 0;
+    source.costStamp = costEpoch;
+    q.push({0, &source});
+    while (!q.empty()) {
+        auto [c, node] = q.top();
         q.pop();
-        if (cost > minCost) break;
-        if (curr.back() == dest) {
-            res.push_back(curr);
-            minCost = cost;
-            continue;
+        if (c != cost(*node)) continue; // Found a cheaper way since
+        if (c > cost(target)) break; // No more minimum cost paths
+        settled.push_back(node);
+        if (node == &target) continue; // Paths end at the destination
+        for (Edge& edge : node->adj) {
+            Node& next = getNode(*edge.dest);
+            unsigned newCost = c + getCostByType(edge.type);
+            if (newCost < cost(next)) { // Better Path
+                next.cost = newCost;
+                next.costStamp = costEpoch;
+                tight[&next].assign(1, {node, &edge});
+                q.push({newCost, &next});
+            } else if (newCost == cost(next)) tight[&next].emplace_back(node, &edge);
         }
-        list<Edge> edges = getAdj(curr.back());
-        unsigned newCost;
-        for (const Edge& edge : edges) {
-            if (type != INVALID && (type != edge.type)) continue; // Different Train
-            newCost = cost + getCostByType(edge.type);
-            if (newCost <= getCost(edge.dest)) { // Better Path
-                setCost(edge.dest, newCost);
-                curr.push_back(edge.dest);
-                q.push({{curr, type}, newCost});
-                curr.pop_back();
-            }
+    }
+    if (cost(target) == UINT_MAX) return {};
+
+    // The DAG is what is left of those edges walking back from the destination
+    unordered_set<Node*> onDAG = {&target};
+    vector<Node*> stack = {&target};
+    while (!stack.empty()) {
+        Node* node = stack.back();
+        stack.pop_back();
+        for (auto [prev, edge] : tight[node]) {
+            edge->dagStamp = dagEpoch;
+            if (onDAG.insert(prev).second) stack.push_back(prev);
         }
     }
+    vector<Node*> res;
+    for (Node* node : settled)
+        if (onDAG.count(node)) res.push_back(node);
+    if (paths != nullptr) { // Paths to a node are the sum of the paths to the nodes before it
+        unordered_map<Node*, unsigned long long> count = {{&source, 1}};
+        for (Node* node : res)
+            for (auto [prev, edge] : tight[node]) {
+                unsigned long long& total = count[node];
+                total = total > ULLONG_MAX - count[prev] ? ULLONG_MAX : total + count[prev];
+            }
+        *paths = count[&target];
+    }
     return res;
 }
 
-list<string> RailNetwork::BFSActive(const string &src, const string &dest) {
+vector<RailNetwork::Edge*> RailNetwork::BFSActive(const string &src, const string &dest, const Scenario& scenario) {
+    return BFSPath(src, dest, [this, &scenario](const Node& from, const Edge& edge) {
+        if (getFlow(edge) == edge.capacity) return false; // if segment flow is full dont add node to queue
+        if (scenario.segmentDisabled(from.name, *edge.dest)) return false; // if edge is deactivated
+        return !scenario.stationDisabled(*edge.dest); // if destination station is deactivated
+    });
+}
+
+list<string> RailNetwork::distancedNodes(const string& src, unsigned distance) {
     clearVisits();
-    clearPrevs();
-    queue<pair<string, SegmentType>> q;
-    q.push({src, INVALID});
+    vector<pair<Node*, unsigned>> q = {{&getNode(src), 0}};
     list<string> res;
-    while (!q.empty()) { // No more Nodes
-        auto [curr, type] = q.front();
-        visit(curr, type);
-        list<Edge> edges = getAdj(curr);
-        q.pop();
-        for (const Edge& edge : edges) {
-            if (type != INVALID && (type != edge.type)) continue; // Different Train
-            if (!edge.active) continue; // if edge is deactivated
-            if (!getNode(edge.dest).active) continue; // if destination station is deactivated
-            if (edge.flow == edge.capacity) continue; // if segment flow is full dont add node to queue
-            if (isVisited(edge.dest)) continue;
-            if (isVisited(edge.dest, edge.type)) continue;
-            setPrev(edge.dest, curr, edge.type);
-            q.push({edge.dest, edge.type});
-            if (edge.dest == dest) goto found_destination;
-        }
-    }
-    goto skip_found_destination;
-    found_destination:
-    res.push_front(dest);
-    if (getNode(dest).prevAlfa.empty()){ // Standard
-        while (true) {
-            if (res.front() == src) break;
-            Node& aux = getNode(res.front());
-            string prev = aux.prevStandard.empty() ? aux.prev : aux.prevStandard;
-            res.push_front(prev);
+    for (size_t head = 0; head < q.size(); head++) { // No more Nodes
+        auto [curr, dist] = q[head];
+        curr->visitedStamp[INVALID] = visitEpoch;
+        if (dist > distance) break; // No more distant nodes
+        if (dist == distance) {
+            res.push_back(curr->name);
+            continue; // Its neighbours are too far
         }
-    } else { // Alfa
-        while (true) {
-            if (res.front() == src) break;
-            Node& aux = getNode(res.front());
-            string prev = aux.prevAlfa.empty() ? aux.prev : aux.prevAlfa;
-            res.push_front(prev);
+        for (Edge& edge : curr->adj) {
+            Node& next = target(edge);
+            if (!isVisited(next, INVALID)) q.emplace_back(&next, dist + 1);
         }
     }
-    skip_found_destination:
     return res;
 }
 
-list<string> RailNetwork::distancedNodes(const string& src, unsigned distance) {
-    clearVisits();
-    queue<pair<string, unsigned>> q;
-    q.push({src, 0});
-    list<string> res;
-    while (!q.empty()) { // No more Nodes
-        auto [curr, dist] = q.front();
-        visit(curr);
-        q.pop();
-        if (dist > distance) break; // No more distant nodes
-        if (dist == distance) res.push_back(curr);
-        for (const Edge& edge : getAdj(curr))
-            if (!isVisited(edge.dest))
-                q.push({edge.dest, dist + 1});
+unordered_map<string, list<string>> RailNetwork::distanceTwoNodes() {
+    // Same order as distancedNodes: nodes are only marked as visited when popped, so a neighbour
+    // still shows up at distance two when it is reached before being popped itself.
+    unordered_map<string, list<string>> res;
+    for (const auto& [name, node] : nodes) {
+        list<string>& ring = res[name];
+        unordered_set<string> popped = {name};
+        for (const Edge& first : node.adj) {
+            popped.insert(*first.dest);
+            for (const Edge& second : getNode(*first.dest).adj)
+                if (popped.find(*second.dest) == popped.end())
+                    ring.push_back(*second.dest);
+        }
     }
     return res;
 }
 
+vector<RailNetwork::Node*> RailNetwork::BFSOrder(Node &source) {
+    source.visitedStamp[INVALID] = visitEpoch;
+    vector<Node*> q = {&source};
+    for (size_t head = 0; head < q.size(); head++)
+        for (Edge& edge : q[head]->adj) {
+            Node& next = target(edge);
+            if (isVisited(next, INVALID)) continue;
+            next.visitedStamp[INVALID] = visitEpoch;
+            q.push_back(&next);
+        }
+    return q;
+}
+
 // []===========================================[] //
 // ||          ALGORITHMIC FUNCTIONS            || //
 // []===========================================[] //
 
-unsigned RailNetwork::maxFlow(const string &origin, const string &destination) {
+unsigned RailNetwork::maxFlow(const string &origin, const string &destination, const Cancellation& control) {
     // Exercise [2.1]
     clearFlow();
     unsigned maxFlow = 0;
-    while(true){
-        list<string> res = BFSFlow(origin, destination);
+    if (!components->connected(origin, destination)) {
+        clearVisits(); // So the cut is empty too
+        return maxFlow;
+    }
+    while(!control.stop()){
+        vector<Edge*> res = BFSFlow(origin, destination);
         if (res.empty()) break;
-        unsigned bottleneck = UINT_MAX;
-        auto it = res.begin();
-        auto itNext = res.begin();
-        itNext++;
-        while (itNext != res.end()) { // find bottleneck in the shortest path
-            const Edge& edge = getEdge(*it, *itNext);
-            unsigned remaining = edge.capacity - edge.flow;
-            if (remaining < bottleneck) bottleneck = remaining;
-            it++; itNext++;
-        }
-        it = res.begin();
-        itNext = res.begin();
-        itNext++;
-        maxFlow += bottleneck;
-        while (itNext != res.end()) { // find bottleneck in the shortest path
-            Edge& edge = getEdge(*it, *itNext);
-            edge.flow += bottleneck;
-            it++; itNext++;
-        }
+        maxFlow += augment(res);
     }
     return maxFlow;
 }
 
-pair<list<pair<string,string>>, unsigned> RailNetwork::importantStations() {
+pair<list<pair<string,string>>, unsigned> RailNetwork::importantStations(const Cancellation& control) {
     // Exercise [2.2]
-    unsigned maxF = 0;
     list<pair<string, string>> pairs;
-    multiset<pair<string, unsigned>, GreaterCompare<string>> orderedNodes;
-    for (const auto& [name, node] : nodes) {
-        unsigned aux = 0;
-        for (const auto& e : node.adj) aux += e.capacity;
-        orderedNodes.insert({name, aux});
-    }
-    for (const auto& [name1, outDeg1] : orderedNodes) {
-        for (const auto& [name2, outDeg2] : orderedNodes) {
-            if (name1 == name2) continue;
-            if (outDeg1 < maxF) continue;
-            unsigned flow = maxFlow(name1, name2);
-            if (flow > maxF) {
-                pairs = list<pair<string, string>>{{name1, name2}};
-                maxF = flow;
-            } else if (flow == maxF) pairs.emplace_back(name1, name2);
-        }
-    }
+    unsigned maxF = allPairsMaxFlow(&pairs, control, true, Parallel::workerCount(nodes.size()));
     return {pairs, maxF};
 }
 
-list<pair<string, unsigned>> RailNetwork::topMunicipalities(int k, const unordered_map<string, Station>& stations) {
-    // Exercise [2.3]
-    // Where should management assign larger budgets?
-    // Ans: To municipalities where there are more trains (Max Flow).
-    unordered_map<string, RailNetwork> municipalities;
-    for (auto& [name, node] : nodes) {
-        const string& municipality = stations.at(name).municipality;
-        municipalities[municipality].addNode(name, {});
-        for (const auto& edge : node.adj)
-            if (stations.at(edge.dest).municipality == municipality)
-                municipalities.at(municipality).addEdge(name, edge);
-    }
-    priority_queue<pair<string, unsigned>, vector<pair<string, unsigned>>, LessCompare<string>> munMaxFlows;
-    for (auto& [municipality, graph] : municipalities) {
-        unsigned maxF = 0;
+/**
+ * The candidate pairs of an all-pairs search, and what the workers solving them share: the next pair to solve, the best
+ * flow so far, the cuts found and the pairs that reach the best flow. Each worker runs its flows on its own copy of the
+ * network. Pairs are taken in order of bound, so every worker stops as soon as the next bound falls below the best
+ * flow, and a pair is only skipped if it can't reach the best flow, so the result is the same for any number of workers.
+ * The pairs are never all listed: nodes are indexed by outgoing capacity and the destinations of each component sorted
+ * by incoming capacity, so the pairs of each origin come out by bound as it walks them, and the origins are merged on a
+ * heap, each joining it once its outgoing capacity (the highest bound it can have) is reached.
+ */
+struct RailNetwork::PairSearch {
+    struct Candidate { unsigned bound; size_t origin, destination; };
+    // The next pair of an origin: at indexes its component's destinations, then every node (the pairs with no flow)
+    struct Row { unsigned bound; size_t origin, at; };
+    struct RowOrder {
+        bool operator()(const Row& a, const Row& b) const {
+            return a.bound != b.bound ? a.bound < b.bound : a.origin > b.origin; // Highest bound, then first origin, on top
+        }
+    };
+    // A cut is a set S of nodes: any flow from inside S to outside of it is at most the capacity leaving S
+    struct Cut { unsigned capacity; vector<bool> inside; };
+    vector<const string*> names;
+    unordered_map<string, size_t> index;
+    vector<pair<unsigned, unsigned>> arcs; // The same segments by index, to sweep the residual graph
+    Frontier frontier;
+    vector<unsigned> component;
+    vector<unsigned> outCap, inCap;
+    vector<vector<size_t>> destinations; // Of each component, by incoming capacity, largest first
+    vector<size_t> group; // The component of each node, as an index in destinations
+    vector<size_t> byIncoming; // Every node, likewise
+    size_t total = 0; // Ordered pairs of distinct nodes
+    mutex pairMutex;
+    priority_queue<Row, vector<Row>, RowOrder> rows;
+    size_t nextOrigin = 0;
+    atomic<size_t> taken{0}, done{0};
+    atomic<bool> exhausted{false};
+    atomic<unsigned> maxF{0};
+    mutex cutMutex;
+    vector<Cut> cuts;
+    atomic<size_t> published{0}; // Cuts other workers can copy
+    mutex resultMutex; // Also serializes the progress reports
+    unsigned bestFlow = 0;
+    vector<pair<size_t, size_t>> best;
+
+    /**
+     * @brief Indexes the nodes of a network by capacity, to take their pairs by bound.
+     * @param graph The network, which must not change while the search lasts.
+     */
+    explicit PairSearch(const RailNetwork& graph) {
+        // Same order as the plain double loop, so ties come out the same way
         multiset<pair<string, unsigned>, GreaterCompare<string>> orderedNodes;
         for (const auto& [name, node] : graph.nodes) {
             unsigned aux = 0;
             for (const auto& e : node.adj) aux += e.capacity;
             orderedNodes.insert({name, aux});
         }
-        for (const auto& [name1, outDeg1] : orderedNodes) {
-            for (const auto& [name2, outDeg2] : orderedNodes) {
-                if (name1 == name2) continue;
-                if (outDeg1 < maxF) continue;
-                unsigned flow = graph.maxFlow(name1, name2);
-                if (flow > maxF) maxF = flow;
+        const size_t n = orderedNodes.size();
+        inCap.assign(n, 0);
+        for (const auto& [name, outDeg] : orderedNodes) {
+            index.emplace(name, names.size());
+            names.push_back(&graph.nodes.find(name)->first);
+            outCap.push_back(outDeg);
+        }
+        for (size_t i = 0; i < n; i++)
+            for (const Edge& e : graph.nodes.at(*names[i]).adj) {
+                auto it = index.find(*e.dest);
+                if (it == index.end()) continue;
+                inCap[it->second] += e.capacity;
+                arcs.emplace_back(i, it->second);
             }
+        frontier = Frontier(n, arcs);
+
+        // Regions are often split in several components, and pairs across them have no flow at all
+        const ComponentIndex reach = graph.components->empty() ? ComponentIndex(graph) : *graph.components;
+        unordered_map<unsigned, size_t> groups;
+        for (const string* name : names) {
+            component.push_back(reach.componentOf(*name));
+            auto it = groups.emplace(component.back(), groups.size()).first;
+            group.push_back(it->second);
+        }
+        byIncoming.resize(n);
+        for (size_t i = 0; i < n; i++) byIncoming[i] = i;
+        stable_sort(byIncoming.begin(), byIncoming.end(), [this](size_t a, size_t b) { return inCap[a] > inCap[b]; });
+        destinations.resize(groups.size());
+        for (size_t j : byIncoming) destinations[group[j]].push_back(j);
+        total = n * (n - (n > 0));
+
+        for (auto& [bridge, side] : graph.blockIndex->bridgeSides(names)) { // Each side of a bridge is a cut
+            Cut cut{0, std::move(side)};
+            for (const Edge& e : graph.nodes.at(bridge.first).adj)
+                if (*e.dest == bridge.second) cut.capacity = e.capacity;
+            if (n > 0 && cut.capacity < outCap[0]) cuts.push_back(std::move(cut)); // No pair is bounded higher
         }
-        munMaxFlows.push({municipality, maxF});
+        published = cuts.size();
     }
-    list<pair<string, unsigned>> res;
-    for (int i = 0; i < k; i++) {
-        if (munMaxFlows.empty()) break;
-        res.push_back(munMaxFlows.top());
-        munMaxFlows.pop();
+
+    /**
+     * @brief Moves a row to its next pair (or keeps it, if it is a pair already) and sets its bound.
+     * @param row The row.
+     * @return False if the origin has no pair left.
+     */
+    bool seek(Row& row) const {
+        const vector<size_t>& own = destinations[group[row.origin]];
+        for (; row.at < own.size(); row.at++) {
+            if (own[row.at] == row.origin) continue;
+            row.bound = min(outCap[row.origin], inCap[own[row.at]]);
+            return true;
+        }
+        for (; row.at < own.size() + byIncoming.size(); row.at++) {
+            if (group[byIncoming[row.at - own.size()]] == group[row.origin]) continue;
+            row.bound = 0;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Takes the pair with the highest bound left.
+     * @param c Set to the pair.
+     * @return False if no pair is left.
+     */
+    bool take(Candidate& c) {
+        lock_guard<mutex> lock(pairMutex);
+        if (exhausted) return false;
+        // Origins are by outgoing capacity, so none left can have a pair bounded higher than the next one's capacity
+        while (nextOrigin < outCap.size() && (rows.empty() || outCap[nextOrigin] >= rows.top().bound)) {
+            Row row{0, nextOrigin++, 0};
+            if (seek(row)) rows.push(row);
+        }
+        if (rows.empty()) {
+            exhausted = true;
+            return false;
+        }
+        Row row = rows.top();
+        rows.pop();
+        const vector<size_t>& own = destinations[group[row.origin]];
+        c = {row.bound, row.origin, row.at < own.size() ? own[row.at] : byIncoming[row.at - own.size()]};
+        row.at++;
+        if (seek(row)) rows.push(row);
+        taken++;
+        return true;
+    }
+
+    /**
+     * @brief Checks if every pair was solved or skipped.
+     * @return True if no pair is left.
+     */
+    bool finished() const {
+        return exhausted;
     }
+
+    /**
+     * @brief Returns how many pairs weren't taken yet.
+     * @return The number of pairs.
+     */
+    size_t remaining() const {
+        return exhausted ? 0 : total - taken;
+    }
+
+    /**
+     * @brief Solves pairs until none is left (or the search is stopped).
+     * @param workspace The worker's copy of the network.
+     * @param control Stops the search early.
+     * @param reportProgress Whether to report the pairs solved or skipped through control.
+     */
+    void solve(RailNetwork& workspace, const Cancellation& control, bool reportProgress) {
+        const size_t n = names.size();
+        vector<const Edge*> arcEdges;
+        arcEdges.reserve(arcs.size());
+        for (size_t i = 0; i < n; i++)
+            for (const Edge& e : workspace.getNode(*names[i]).adj)
+                if (index.count(*e.dest)) arcEdges.push_back(&e);
+        vector<Cut> known;
+        vector<vector<unsigned>> knownFrom(n); // The known cuts each node is inside of, so only those an origin is in are checked
+        unsigned localFlow = 0;
+        vector<pair<size_t, size_t>> localBest;
+        for (Candidate c{}; take(c);) {
+            const unsigned bestSoFar = maxF;
+            if (c.bound < bestSoFar) { // Every remaining bound is as small
+                exhausted = true;
+                break;
+            }
+            if (reportProgress) {
+                size_t d = ++done;
+                if (d % n == 0) {
+                    lock_guard<mutex> lock(resultMutex);
+                    control.progress(d, total);
+                }
+            }
+            if (published > known.size()) {
+                lock_guard<mutex> lock(cutMutex);
+                for (size_t k = known.size(); k < cuts.size(); k++) {
+                    known.push_back(cuts[k]);
+                    for (size_t j = 0; j < n; j++)
+                        if (known.back().inside[j]) knownFrom[j].push_back((unsigned) k);
+                }
+            }
+            bool cutOff = false;
+            for (unsigned k : knownFrom[c.origin])
+                if (known[k].capacity < bestSoFar && !known[k].inside[c.destination]) { cutOff = true; break; }
+            if (cutOff) continue;
+            if (control.stop()) break;
+            bool reachable = component[c.origin] == component[c.destination];
+            unsigned flow = reachable ? workspace.maxFlow(*names[c.origin], *names[c.destination], control) : 0;
+            if (flow > localFlow) {
+                localBest.clear();
+                localFlow = flow;
+            }
+            if (flow == localFlow) localBest.emplace_back(c.origin, c.destination);
+            for (unsigned prev = maxF; flow > prev && !maxF.compare_exchange_weak(prev, flow);) {}
+            if (control.interrupted()) break;
+            if (!reachable) continue;
+
+            // The nodes still reachable through unsaturated segments make a cut that bounds every pair it separates
+            Cut cut{0, frontier.reach({(unsigned) c.origin}, [&](unsigned arc) {
+                return workspace.getFlow(*arcEdges[arc]) < arcEdges[arc]->capacity;
+            })};
+            for (size_t j = 0; j < n; j++) {
+                if (!cut.inside[j]) continue;
+                for (const Edge& e : workspace.getNode(*names[j]).adj) {
+                    auto it = index.find(*e.dest);
+                    if (it == index.end() || !cut.inside[it->second]) cut.capacity += e.capacity;
+                }
+            }
+            if (cut.capacity < c.bound) { // Otherwise it can't beat any remaining bound
+                lock_guard<mutex> lock(cutMutex);
+                cuts.push_back(std::move(cut));
+                published = cuts.size();
+            }
+        }
+        lock_guard<mutex> lock(resultMutex);
+        if (localFlow > bestFlow) {
+            best.clear();
+            bestFlow = localFlow;
+        }
+        if (localFlow == bestFlow) best.insert(best.end(), localBest.begin(), localBest.end());
+    }
+};
+
+unsigned RailNetwork::allPairsMaxFlow(list<pair<string, string>>* pairs, const Cancellation& control, bool reportProgress, unsigned workers) {
+    PairSearch search(*this);
+    vector<RailNetwork> workspaces(workers > 1 ? workers - 1 : 0, *this); // Copied before this one changes
+    Parallel::forEachWorker(workers, [&](unsigned worker) {
+        search.solve(worker == 0 ? *this : workspaces[worker - 1], control, reportProgress);
+    });
+    if (reportProgress && !control.interrupted()) control.progress(search.total, search.total);
+
+    if (pairs != nullptr) {
+        sort(search.best.begin(), search.best.end());
+        pairs->clear();
+        for (const auto& [i, j] : search.best)
+            pairs->emplace_back(*search.names[i], *search.names[j]);
+    }
+    return search.maxF;
+}
+
+list<pair<string, unsigned>> RailNetwork::topRegions(int k, const unordered_map<string, RailNetwork>& regions, const Cancellation& control, unsigned workers) {
+    // Regions are started from the largest, whose searches take the longest. A worker with no region left to start
+    // joins the started search with the most pairs left, so the largest regions end up split across all workers.
+    vector<pair<const string*, const RailNetwork*>> order;
+    for (const auto& [name, graph] : regions)
+        order.emplace_back(&name, &graph);
+    sort(order.begin(), order.end(), [](const auto& a, const auto& b) {
+        size_t sa = a.second->nodes.size(), sb = b.second->nodes.size();
+        return sa != sb ? sa > sb : *a.first < *b.first;
+    });
+    struct Job {
+        unique_ptr<PairSearch> search;
+        atomic<bool> ready{false};
+        atomic<unsigned> workers{0};
+        atomic<bool> counted{false};
+    };
+    vector<Job> jobs(order.size());
+    atomic<size_t> nextJob(0), preparing(0), finished(0);
+    mutex progressMutex;
+    auto work = [&](size_t j, vector<unique_ptr<RailNetwork>>& workspaces) {
+        Job& job = jobs[j];
+        job.workers++;
+        unique_ptr<RailNetwork>& workspace = workspaces[j];
+        if (!workspace) workspace = make_unique<RailNetwork>(*order[j].second); // The region is only read, so it can be copied at any time
+        job.search->solve(*workspace, control, false);
+        if (job.search->finished()) workspace.reset(); // Nothing left to come back to it for
+        if (--job.workers == 0 && job.search->finished() && !job.counted.exchange(true)) {
+            lock_guard<mutex> lock(progressMutex);
+            control.progress(++finished, jobs.size());
+        }
+    };
+    Parallel::forEachWorker(workers == 0 ? Parallel::workerCount(SIZE_MAX) : workers, [&](unsigned) {
+        vector<unique_ptr<RailNetwork>> workspaces(jobs.size()); // This worker's copy of each region it works on
+        while (!control.stop()) {
+            preparing++;
+            size_t j = nextJob++;
+            if (j < jobs.size()) {
+                jobs[j].search = make_unique<PairSearch>(*order[j].second);
+                jobs[j].ready = true;
+                preparing--;
+                work(j, workspaces);
+                continue;
+            }
+            preparing--;
+            size_t steal = jobs.size(), most = 0;
+            for (size_t i = 0; i < jobs.size(); i++) {
+                if (!jobs[i].ready || jobs[i].search->finished()) continue;
+                size_t left = jobs[i].search->remaining();
+                if (left > most) {
+                    most = left;
+                    steal = i;
+                }
+            }
+            if (steal < jobs.size()) work(steal, workspaces);
+            else if (preparing == 0) break; // No search left to join, nor about to start
+            else this_thread::yield();
+        }
+    });
+
+    // Regions the search didn't reach (when stopped) are left out
+    auto higher = [](const pair<string, unsigned>& a, const pair<string, unsigned>& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    };
+    priority_queue<pair<string, unsigned>, vector<pair<string, unsigned>>, decltype(higher)> top(higher); // The k highest, lowest on top
+    for (size_t j = 0; j < jobs.size() && k > 0; j++) {
+        if (!jobs[j].ready) continue;
+        top.emplace(*order[j].first, jobs[j].search->maxF);
+        if (top.size() > (size_t) k) top.pop();
+    }
+    list<pair<string, unsigned>> res;
+    for (; !top.empty(); top.pop())
+        res.push_front(top.top());
     return res;
 }
-list<pair<string, unsigned>> RailNetwork::topDistricts(int k, const unordered_map<string, Station>& stations) {
+
+unordered_map<string, RailNetwork> RailNetwork::groupNetworks(const StationIndex& index, StationAttribute attribute) {
+    unordered_map<string, RailNetwork> groups;
+    vector<Node*> members;
+    for (const auto& [value, ids] : index.groupsBy(attribute)) {
+        clearVisits(); // Members are marked, so the edges kept are found without looking their ends up
+        members.clear();
+        for (unsigned id : ids) {
+            Node& node = getNode(index.name(id));
+            node.visitedStamp[INVALID] = visitEpoch;
+            members.push_back(&node);
+        }
+        RailNetwork& group = groups[value];
+        group.capacityPolicy = capacityPolicy;
+        for (Node* node : members) {
+            group.addNode(node->name, {});
+            for (auto& edge : node->adj)
+                if (isVisited(target(edge), INVALID)) group.addEdge(node->name, edge);
+        }
+    }
+    return groups;
+}
+
+list<pair<string, unsigned>> RailNetwork::topGroups(int k, const StationIndex& index, StationAttribute attribute, const Cancellation& control, unsigned workers) {
     // Exercise [2.3]
     // Where should management assign larger budgets?
-    // Ans: To districts where there are more trains (Max Flow).
-    unordered_map<string, RailNetwork> districts;
-    for (auto& [name, node] : nodes) {
-        const string& district = stations.at(name).district;
-        districts[district].addNode(name, {});
-        for (const auto& edge : node.adj)
-            if (stations.at(edge.dest).district == district)
-                districts.at(district).addEdge(name, edge);
-    }
-    priority_queue<pair<string, unsigned>, vector<pair<string, unsigned>>, LessCompare<string>> disMaxFlows;
-    for (auto& [district, graph] : districts) {
-        unsigned maxF = 0;
-        multiset<pair<string, unsigned>, GreaterCompare<string>> orderedNodes;
-        for (const auto& [name, node] : graph.nodes) {
-            unsigned aux = 0;
-            for (const auto& e : node.adj) aux += e.capacity;
-            orderedNodes.insert({name, aux});
+    // Ans: To municipalities and districts where there are more trains (Max Flow).
+    return topRegions(k, groupNetworks(index, attribute), control, workers);
+}
+
+RailNetwork RailNetwork::lineNetwork(const StationIndex& index, const string& line) {
+    clearVisits(); // Stations of the line are marked, so junctions are told apart without looking them up
+    vector<Node*> members;
+    for (unsigned id : index.members(LINE, line)) {
+        Node& node = getNode(index.name(id));
+        node.visitedStamp[INVALID] = visitEpoch;
+        members.push_back(&node);
+    }
+    RailNetwork res;
+    res.capacityPolicy = capacityPolicy;
+    for (Node* node : members)
+        res.addNode(node->name, node->adj);
+    for (Node* node : members)
+        for (Edge& edge : node->adj) {
+            Node& junction = target(edge);
+            if (isVisited(junction, INVALID) || res.nodes.count(junction.name)) continue;
+            res.addNode(junction.name, {});
+            for (Edge& back : junction.adj)
+                if (isVisited(target(back), INVALID)) res.addEdge(junction.name, back);
         }
-        for (const auto& [name1, outDeg1] : orderedNodes) {
-            for (const auto& [name2, outDeg2] : orderedNodes) {
-                if (name1 == name2) continue;
-                if (outDeg1 < maxF) continue;
-                unsigned flow = graph.maxFlow(name1, name2);
-                if (flow > maxF) maxF = flow;
+    return res;
+}
+
+vector<LineReport> RailNetwork::lineReports(const StationIndex& index) {
+    unordered_map<const Node*, const string*> lineOf;
+    for (const auto& [line, ids] : index.groupsBy(LINE))
+        for (unsigned id : ids)
+            lineOf.emplace(&getNode(index.name(id)), &line);
+    vector<LineReport> reports;
+    for (const auto& [line, ids] : index.groupsBy(LINE)) {
+        reports.emplace_back();
+        reports.back().line = line;
+        reports.back().stations = (unsigned) ids.size();
+    }
+    sort(reports.begin(), reports.end(), [](const LineReport& a, const LineReport& b) { return a.line < b.line; });
+    vector<RailNetwork> lines;
+    vector<size_t> jobs; // Largest lines first, so the last line started isn't a long one
+    for (size_t i = 0; i < reports.size(); i++) {
+        LineReport& report = reports[i];
+        lines.push_back(lineNetwork(index, report.line));
+        for (unsigned id : index.members(LINE, report.line)) {
+            Node& junction = getNode(index.name(id));
+            map<string, unsigned> capacities; // To each other line
+            for (Edge& edge : junction.adj) {
+                const string& other = *lineOf.at(&target(edge));
+                if (other != report.line) capacities[other] += edge.capacity;
             }
+            for (const auto& [other, capacity] : capacities)
+                report.transfers.push_back({junction.name, other, capacity});
         }
-        disMaxFlows.push({district, maxF});
+        jobs.push_back(i);
     }
-    list<pair<string, unsigned>> res;
-    for (int i = 0; i < k; i++) {
-        if (disMaxFlows.empty()) break;
-        res.push_back(disMaxFlows.top());
-        disMaxFlows.pop();
+    stable_sort(jobs.begin(), jobs.end(), [&reports](size_t a, size_t b) { return reports[a].stations > reports[b].stations; });
+    atomic<size_t> next(0);
+    Parallel::forEachWorker(Parallel::workerCount(jobs.size()), [&](unsigned) {
+        for (size_t j = next++; j < jobs.size(); j = next++) { // Lines share nothing, so no copies are needed
+            LineReport& report = reports[jobs[j]];
+            RailNetwork& line = lines[jobs[j]];
+            unordered_set<const Node*> own;
+            for (unsigned id : index.members(LINE, report.line))
+                own.insert(&line.getNode(index.name(id)));
+            auto lastOwn = [&own](const vector<Node*>& order) {
+                return *find_if(order.rbegin(), order.rend(), [&own](const Node* node) { return own.count(node) > 0; });
+            };
+            // Another line may run a stretch of this one, splitting it in pieces: each is found from its first station
+            line.clearVisits();
+            vector<Node*> starts;
+            for (unsigned id : index.members(LINE, report.line)) {
+                Node& station = line.getNode(index.name(id));
+                if (line.isVisited(station, INVALID)) continue;
+                vector<Node*> piece = line.BFSOrder(station);
+                LinePiece res;
+                res.stations = (unsigned) count_if(piece.begin(), piece.end(), [&own](const Node* node) { return own.count(node) > 0; });
+                report.pieces.push_back(res);
+                starts.push_back(lastOwn(piece)); // Farthest from where the piece was found, then the farthest from it
+            }
+            auto piece = report.pieces.begin();
+            for (Node* origin : starts) {
+                line.clearVisits();
+                piece->origin = origin->name;
+                piece->destination = lastOwn(line.BFSOrder(*origin))->name;
+                if (piece->origin != piece->destination) { // Not a single station, nor one without segments
+                    piece->flow = line.maxFlow(piece->origin, piece->destination);
+                    piece->bottlenecks = line.lastMinCut().segments;
+                }
+                ++piece;
+            }
+            report.pieces.sort([](const LinePiece& a, const LinePiece& b) { return a.stations > b.stations; });
+        }
+    });
+    return reports;
+}
+
+unsigned RailNetwork::superSourceFlow(const string &station, const list<string> &sources) {
+    Node& sourceNode = nodes.try_emplace(sourceNodeName, sourceNodeName, list<Edge>()).first->second;
+    sourceNode.adj.clear();
+    for (const string& node : sources)
+        sourceNode.adj.emplace_back(intern(node), INVALID, UINT_MAX);
+    return maxFlow(sourceNodeName, station);
+}
+
+unsigned RailNetwork::scaledFlow(const string &origin, const string &destination, unsigned phases) {
+    clearFlow();
+    unsigned maxCapacity = 0;
+    for (const auto& [name, node] : nodes)
+        for (const Edge& edge : node.adj)
+            if (edge.capacity != UINT_MAX && edge.capacity > maxCapacity) maxCapacity = edge.capacity;
+    unsigned delta = 1;
+    while (delta <= maxCapacity / 2) delta *= 2;
+    unsigned flow = 0;
+    for (unsigned phase = 0; phase < phases && delta > 0; phase++, delta /= 2) {
+        while (true) {
+            vector<Edge*> path = BFSFlow(origin, destination, delta);
+            if (path.empty()) break;
+            flow += augment(path);
+        }
+    }
+    return flow;
+}
+
+unsigned RailNetwork::augment(const vector<Edge*>& path) {
+    unsigned bottleneck = UINT_MAX;
+    for (const Edge* edge : path) // find bottleneck in the shortest path
+        bottleneck = min(bottleneck, edge->capacity - getFlow(*edge));
+    for (Edge* edge : path)
+        addFlow(*edge, bottleneck);
+    return bottleneck;
+}
+
+const RailNetwork::ArcLayout& RailNetwork::arcLayout() {
+    if (layout != nullptr) return *layout;
+    auto res = make_unique<ArcLayout>();
+    for (const auto& [name, node] : nodes)
+        if (name != sourceNodeName) res->ids.emplace(&node, res->ids.size());
+    for (auto& [name, node] : nodes) {
+        if (name == sourceNodeName) continue;
+        for (Edge& edge : node.adj) {
+            res->arcs.emplace_back(res->ids.at(&node), res->ids.at(&target(edge)));
+            res->arcEdges.push_back(&edge);
+        }
+    }
+    res->frontier = Frontier(res->ids.size(), res->arcs);
+    layout = std::move(res);
+    return *layout;
+}
+
+unsigned RailNetwork::cutBound(const string &origin, const string &destination) {
+    // The residual graph is swept from both ends (on all cores, if it is large). The super source is left out of the
+    // layout, which it would change on every query: its edges are never saturated, so it reaches what its targets reach.
+    const ArcLayout& net = arcLayout();
+    auto unsaturated = [&net, this](unsigned arc) { return getFlow(*net.arcEdges[arc]) < net.arcEdges[arc]->capacity; };
+    const unsigned d = net.ids.at(&getNode(destination));
+    const bool super = origin == sourceNodeName;
+    vector<unsigned> sources;
+    unsigned long long out = 0, in = 0;
+    if (super)
+        for (Edge& edge : getNode(origin).adj) {
+            sources.push_back(net.ids.at(&target(edge)));
+            out += edge.capacity;
+        }
+    else sources.push_back(net.ids.at(&getNode(origin)));
+    for (size_t arc = 0; arc < net.arcs.size(); arc++) {
+        if (!super && net.arcs[arc].first == sources[0]) out += net.arcEdges[arc]->capacity;
+        if (net.arcs[arc].second == d) in += net.arcEdges[arc]->capacity;
     }
+    unsigned long long bound = min(out, in);
+
+    vector<bool> side = net.frontier.reach(sources, unsaturated); // Source side
+    if (!side[d]) {
+        unsigned long long capacity = 0;
+        for (size_t arc = 0; arc < net.arcs.size(); arc++)
+            if (side[net.arcs[arc].first] && !side[net.arcs[arc].second]) capacity += net.arcEdges[arc]->capacity;
+        return (unsigned) min(bound, capacity);
+    }
+    side = net.frontier.reach({d}, unsaturated, true); // Sink side
+    if (none_of(sources.begin(), sources.end(), [&side](unsigned source) { return side[source]; })) {
+        unsigned long long capacity = 0;
+        for (size_t arc = 0; arc < net.arcs.size(); arc++)
+            if (!side[net.arcs[arc].first] && side[net.arcs[arc].second]) capacity += net.arcEdges[arc]->capacity;
+        bound = min(bound, capacity);
+    }
+    return (unsigned) min(bound, (unsigned long long) UINT_MAX);
+}
+
+FlowBounds RailNetwork::maxFlowApprox(const string &origin, const string &destination, unsigned phases) {
+    unsigned lower = scaledFlow(origin, destination, phases);
+    return {lower, max(lower, cutBound(origin, destination))};
+}
+
+FlowBounds RailNetwork::maxFlowStationApprox(const string &station, unsigned phases) {
+    list<string> nodesAtDistanceTwo = distancedNodes(station, 2);
+    if (nodesAtDistanceTwo.empty()) {
+        unsigned sum = maxFlowStation(station);
+        return {sum, sum};
+    }
+    Node& sourceNode = nodes.try_emplace(sourceNodeName, sourceNodeName, list<Edge>()).first->second;
+    sourceNode.adj.clear();
+    for (const string& node : nodesAtDistanceTwo)
+        sourceNode.adj.emplace_back(intern(node), INVALID, UINT_MAX);
+    FlowBounds res = maxFlowApprox(sourceNodeName, station, phases);
+    nodes.erase(sourceNodeName);
     return res;
 }
 unsigned RailNetwork::maxFlowStation(const string &station) {
@@ -415,92 +1033,186 @@ unsigned RailNetwork::maxFlowStation(const string &station) {
             sum += edge.capacity;
         return sum;
     }
-    Node sourceNode = Node(sourceNodeName, {});
-    nodes.insert({sourceNodeName, sourceNode});
-    for (const string& node : nodesAtDistanceTwo) {
-        addEdge(sourceNodeName, Edge(sourceNodeName, node, INVALID, UINT_MAX));
-    }
-    unsigned res = maxFlow(sourceNodeName, station);
+    unsigned res = superSourceFlow(station, nodesAtDistanceTwo);
     nodes.erase(sourceNodeName);
     return res;
 }
 
+list<pair<string, unsigned>> RailNetwork::stationsFlowReport(const function<void(const string&, unsigned)>& onResult) {
+    unordered_map<string, list<string>> rings = distanceTwoNodes();
+    vector<pair<string, unsigned>> flows;
+    flows.reserve(nodes.size());
+    for (const auto& [name, _] : nodes)
+        flows.emplace_back(name, 0);
+    atomic<size_t> next(0);
+    mutex resultMutex;
+    Parallel::forEachWorker(Parallel::workerCount(flows.size()), [&](unsigned) {
+        RailNetwork workspace = *this; // Each worker runs its flows on its own copy
+        for (size_t i = next++; i < flows.size(); i = next++) {
+            const string& station = flows[i].first;
+            const list<string>& ring = rings.at(station);
+            unsigned flow = 0;
+            if (ring.empty()) {
+                for (const Edge& edge : workspace.getNode(station).adj)
+                    flow += edge.capacity;
+            } else flow = workspace.superSourceFlow(station, ring);
+            flows[i].second = flow;
+            if (onResult) {
+                lock_guard<mutex> lock(resultMutex);
+                onResult(station, flow);
+            }
+        }
+    });
+    sort(flows.begin(), flows.end(), [](const pair<string, unsigned>& p1, const pair<string, unsigned>& p2) {
+        return p1.second != p2.second ? p1.second > p2.second : p1.first < p2.first;
+    });
+    return {flows.begin(), flows.end()};
+}
 
-unsigned RailNetwork::maxFlowMinCost(const string &origin, const string &destination) {
+unsigned RailNetwork::maxFlowMinCost(const string &origin, const string &destination, unsigned long long* paths) {
     // Exercise [3.1]
-    // 1 - Get all paths with the minimum cost.
+    // 1 - Mark the edges on any path with the minimum cost.
     // 2 - Build a sub-graph with only the nodes and edges that belong to any minCost path.
     // 3 - Calculate max flow of the sub-graph.
+    if (paths != nullptr) *paths = 0;
+    if (!components->connected(origin, destination)) return 0;
     // Step 1:
-    list<list<string>> allPathsMinCost = BFSCost(origin, destination);
+    vector<Node*> dag = minCostDAG(origin, destination, paths);
+    if (dag.empty()) return 0;
     // Step 2:
     RailNetwork subGraph;
-    for (const list<string>& path : allPathsMinCost){
-        string prev;
-        for (const string& node : path) {
-            if (!prev.empty()) {
-                for (auto e : subGraph.getNode(prev).adj)
-                    if (e.dest == node)
-                        goto dont_add_edge;
-                subGraph.addEdge(prev, getEdge(prev, node));
-            }
-            dont_add_edge:
-            if (subGraph.nodes.find(node) == subGraph.nodes.end())
-                subGraph.addNode(node, {});
-            prev = node;
-        }
-    }
+    for (const Node* node : dag)
+        subGraph.addNode(node->name, {});
+    for (const Node* node : dag)
+        for (const Edge& edge : node->adj)
+            if (inDAG(edge)) subGraph.addEdge(node->name, edge);
     // Step 3:
     return subGraph.maxFlow(origin, destination);
 }
 
-unsigned RailNetwork::maxFlowReduced(const string &origin, const string &destination) {
+unsigned RailNetwork::maxFlowReduced(const string &origin, const string &destination, const Scenario& scenario, const Cancellation& control) {
     clearFlow();
     unsigned maxFlow = 0;
-    while(true){
-        list<string> res = BFSActive(origin,destination);
+    if (blockIndex->separated(origin, destination, scenario)) {
+        clearVisits(); // So the cut is empty too
+        return maxFlow;
+    }
+    while(!control.stop()){
+        vector<Edge*> res = BFSActive(origin, destination, scenario);
         if (res.empty()) break;
-        unsigned bottleneck = UINT_MAX;
-        auto it = res.begin();
-        auto itNext = res.begin();
-        itNext++;
-        while (itNext != res.end()) { // find bottleneck in the shortest path
-            const Edge& edge = getEdge(*it, *itNext);
-            unsigned remaining = edge.capacity - edge.flow;
-            if (remaining < bottleneck) bottleneck = remaining;
-            it++; itNext++;
-        }
-        it = res.begin();
-        itNext = res.begin();
-        itNext++;
-        maxFlow += bottleneck;
-        while (itNext != res.end()) { // find bottleneck in the shortest path
-            Edge& edge = getEdge(*it, *itNext);
-            edge.flow += bottleneck;
-            it++; itNext++;
-        }
+        maxFlow += augment(res);
     }
     return maxFlow;
 }
 
-list<pair<string, unsigned>> RailNetwork::topAffectedStations(int k, const unordered_map<string,Station>& stations) {
+vector<unsigned> RailNetwork::maxFlowScenarios(const string &origin, const string &destination, const vector<Scenario> &scenarios) {
+    vector<unsigned> flows(scenarios.size(), 0);
+    atomic<size_t> next(0);
+    Parallel::forEachWorker(Parallel::workerCount(scenarios.size()), [&](unsigned) {
+        RailNetwork workspace = *this; // Each worker runs its flows on its own copy
+        for (size_t i = next++; i < scenarios.size(); i = next++)
+            flows[i] = workspace.maxFlowReduced(origin, destination, scenarios[i]);
+    });
+    return flows;
+}
+
+unsigned RailNetwork::upgradeGain(const string &origin, const string &destination, const string &stationA, const string &stationB, unsigned extra) {
+    vector<Edge*> upgraded;
+    for (const auto& [from, to] : {make_pair(&stationA, &stationB), make_pair(&stationB, &stationA)})
+        for (Edge& edge : getNode(*from).adj)
+            if (*edge.dest == *to) {
+                edge.capacity += extra;
+                upgraded.push_back(&edge);
+            }
+    vector<pair<vector<Edge*>, unsigned>> paths;
+    unsigned gain = 0;
+    while (true) { // The gain is relative to the blocking flow left before the upgrade, not to a maximum flow
+        vector<Edge*> path = BFSFlow(origin, destination);
+        if (path.empty()) break;
+        unsigned sent = augment(path);
+        gain += sent;
+        paths.emplace_back(std::move(path), sent);
+    }
+    for (const auto& [path, sent] : paths)
+        for (Edge* edge : path)
+            subtractFlow(*edge, sent);
+    for (Edge* edge : upgraded)
+        edge->capacity -= extra;
+    return gain;
+}
+
+list<pair<Segment, unsigned>> RailNetwork::rankUpgrades(const list<pair<string, string>> &pairs, unsigned extra, int k) {
+    // Raising a segment outside the cut a flow leaves can't let more of it through, so each pair only tries its cut
+    vector<const pair<string, string>*> odPairs;
+    map<pair<string, string>, pair<Segment, vector<size_t>>> candidates; // By their stations, in order: the pairs they cut
+    for (const auto& od : pairs) {
+        maxFlow(od.first, od.second);
+        for (Segment& segment : lastMinCut().segments) {
+            pair<string, string> key = minmax(segment.origin, segment.destination);
+            auto it = candidates.try_emplace(key, std::move(segment), vector<size_t>()).first;
+            if (it->second.second.empty() || it->second.second.back() != odPairs.size()) it->second.second.push_back(odPairs.size());
+        }
+        odPairs.push_back(&od);
+    }
+    vector<pair<Segment, vector<size_t>>*> jobs;
+    for (auto& [_, candidate] : candidates)
+        jobs.push_back(&candidate);
+    vector<unsigned> gains(jobs.size(), 0);
+    const unsigned workers = Parallel::workerCount(jobs.size());
+    Parallel::forEachWorker(workers, [&](unsigned worker) {
+        // Each worker takes every workers-th candidate, and solves each pair once for all of them before upgrading
+        RailNetwork workspace = *this;
+        vector<vector<size_t>> byPair(odPairs.size());
+        for (size_t i = worker; i < jobs.size(); i += workers)
+            for (size_t od : jobs[i]->second)
+                byPair[od].push_back(i);
+        for (size_t od = 0; od < odPairs.size(); od++) {
+            if (byPair[od].empty()) continue;
+            const auto& [origin, destination] = *odPairs[od];
+            workspace.maxFlow(origin, destination);
+            for (size_t i : byPair[od])
+                gains[i] += workspace.upgradeGain(origin, destination, jobs[i]->first.origin, jobs[i]->first.destination, extra);
+        }
+    });
+    vector<size_t> order;
+    for (size_t i = 0; i < jobs.size(); i++)
+        if (gains[i] > 0) order.push_back(i);
+    stable_sort(order.begin(), order.end(), [&gains](size_t a, size_t b) { return gains[a] > gains[b]; });
+    list<pair<Segment, unsigned>> res;
+    for (size_t i : order) {
+        if ((int) res.size() >= k) break;
+        res.emplace_back(jobs[i]->first, gains[i]);
+    }
+    return res;
+}
+
+list<pair<string, unsigned>> RailNetwork::topAffectedStations(int k, const unordered_map<string,Station>& stations, const Scenario& scenario, const Cancellation& control) {
     priority_queue<pair<string, unsigned>, vector<pair<string, unsigned>>, LessCompare<string>> flowVariance;
+    const ComponentIndex reduced = components->without(scenario);
     for(auto [name, station] : stations){
+        if (control.stop()) break;
         list<string> nodesAtDistanceTwo = distancedNodes(name, 2);
         if (nodesAtDistanceTwo.empty()) {
             unsigned sum = 0;
             for (const Edge& edge : getAdj(name))
                 sum += edge.capacity;
         }
+        if (!blockIndex->touches(nodesAtDistanceTwo, name, scenario)) { // No flow into the station can change
+            flowVariance.emplace(name, 0);
+            control.progress(flowVariance.size(), stations.size());
+            continue;
+        }
         Node sourceNode = Node(sourceNodeName, {});
         nodes.insert({sourceNodeName, sourceNode});
         for (const string& node : nodesAtDistanceTwo) {
-            addEdge(sourceNodeName, Edge(sourceNodeName, node, INVALID, UINT_MAX));
+            addEdge(sourceNodeName, Edge(intern(node), INVALID, UINT_MAX));
         }
-        unsigned normalFlow = maxFlow(sourceNodeName, name);
-        unsigned reducedFlow = maxFlowReduced(sourceNodeName, name);
-        flowVariance.emplace(name, normalFlow - reducedFlow);
+        unsigned normalFlow = maxFlow(sourceNodeName, name, control);
+        unsigned reducedFlow = reduced.connected(nodesAtDistanceTwo, name) ? maxFlowReduced(sourceNodeName, name, scenario, control) : 0;
         nodes.erase(sourceNodeName);
+        if (control.stop()) break; // Interrupted flows can't be compared
+        flowVariance.emplace(name, normalFlow - reducedFlow);
+        control.progress(flowVariance.size(), stations.size());
     }
     list<pair<string, unsigned>> res;
     for (int i = 0; i < k; i++) {
@@ -510,3 +1222,88 @@ list<pair<string, unsigned>> RailNetwork::topAffectedStations(int k, const unord
     }
     return res;
 }
+
+ReliabilityReport RailNetwork::simulateFailures(const string &origin, const string &destination, const FailureModel &model, unsigned long long samples, unsigned seed) {
+    const unsigned long long blockSize = 1024;
+    const unsigned long long blocks = (samples + blockSize - 1) / blockSize;
+    ReliabilityReport report;
+    report.samples = samples;
+    report.intactFlow = maxFlow(origin, destination);
+    // Elements that can fail (a failed segment is out of service in both directions)
+    vector<pair<string, double>> stationsAtRisk;
+    vector<pair<pair<string, string>, double>> segmentsAtRisk;
+    for (const auto& [name, node] : nodes) {
+        double p = model.stationFailure(name);
+        if (p > 0) stationsAtRisk.emplace_back(name, p);
+        for (const Edge& edge : node.adj) {
+            if (*edge.dest < name) {
+                bool hasReverse = false;
+                for (const Edge& e : getNode(*edge.dest).adj)
+                    if (*e.dest == name) hasReverse = true;
+                if (hasReverse) continue; // Already added from the other side
+            }
+            p = model.segmentFailure(name, *edge.dest);
+            if (p > 0) segmentsAtRisk.push_back({{name, *edge.dest}, p});
+        }
+    }
+    atomic<unsigned long long> nextBlock(0);
+    mutex reportMutex;
+    Parallel::forEachWorker(Parallel::workerCount(blocks), [&](unsigned) {
+        RailNetwork workspace = *this; // Each worker runs its flows on its own copy
+        list<string> failedStations;
+        list<pair<string, string>> failedSegments;
+        map<unsigned, unsigned long long> distribution;
+        uniform_real_distribution<double> chance(0.0, 1.0);
+        for (unsigned long long block = nextBlock++; block < blocks; block = nextBlock++) {
+            seed_seq seq{seed, (unsigned) (block >> 32), (unsigned) block};
+            mt19937_64 rng(seq);
+            unsigned long long blockSamples = min(blockSize, samples - block * blockSize);
+            for (unsigned long long i = 0; i < blockSamples; i++) {
+                failedStations.clear();
+                failedSegments.clear();
+                bool endpointFailed = false;
+                for (const auto& [station, p] : stationsAtRisk)
+                    if (chance(rng) < p) {
+                        failedStations.push_back(station);
+                        if (station == origin || station == destination) endpointFailed = true;
+                    }
+                for (const auto& [segment, p] : segmentsAtRisk)
+                    if (chance(rng) < p) {
+                        failedSegments.push_back(segment);
+                        failedSegments.emplace_back(segment.second, segment.first);
+                    }
+                unsigned flow;
+                if (endpointFailed) flow = 0;
+                else if (failedStations.empty() && failedSegments.empty()) flow = report.intactFlow;
+                else {
+                    Scenario scenario(failedSegments, failedStations);
+                    // Failures off every path between the stations leave the flow intact
+                    if (blockIndex->touches({origin}, destination, scenario)) flow = workspace.maxFlowReduced(origin, destination, scenario);
+                    else flow = report.intactFlow;
+                }
+                distribution[flow]++;
+            }
+        }
+        lock_guard<mutex> lock(reportMutex);
+        for (const auto& [flow, count] : distribution)
+            report.distribution[flow] += count;
+    });
+    return report;
+}
+
+MinCut RailNetwork::lastMinCut() {
+    // Trains can't change service mid path, so a node is reached once per service type: a segment is in the cut if
+    // its train could have left the source side but it was saturated before reaching its destination with that type.
+    auto reached = [this](const Node& node, SegmentType type) {
+        return isVisited(node, INVALID) || (type != INVALID && isVisited(node, type));
+    };
+    MinCut cut;
+    for (const auto& [name, node] : nodes) {
+        if (!reached(node, STANDARD) && !reached(node, ALFA_PENDULAR)) continue;
+        if (name != sourceNodeName) cut.sourceSide.push_back(name);
+        for (const Edge& edge : node.adj)
+            if (getFlow(edge) == edge.capacity && reached(node, edge.type) && !reached(getNode(*edge.dest), edge.type))
+                cut.segments.emplace_back(name, *edge.dest, edge.capacity, edge.type);
+    }
+    return cut;
+}
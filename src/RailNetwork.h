@@ -2,60 +2,84 @@
 #ifndef RAILNETWORK_RAILNETWORK_H
 #define RAILNETWORK_RAILNETWORK_H
 
+#include <climits>
+#include <functional>
 #include <list>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 #include <queue>
 
+#include "BlockIndex.h"
+#include "Cancellation.h"
+#include "ComponentIndex.h"
+#include "CopyOnWrite.h"
+#include "FlowBounds.h"
+#include "Frontier.h"
+#include "LineReport.h"
+#include "MinCut.h"
+#include "Reliability.h"
+#include "Scenario.h"
 #include "Segment.h"
 #include "Station.h"
+#include "StationIndex.h"
 /**
  * RailNetwork class represents a directed graph that models a rail network system. It provides methods to calculate
  * maximum flow and other network analysis functions.
  */
 class RailNetwork { // Directed Graph
     static const std::string sourceNodeName;
+    struct Node;
     /**
      * @brief A struct to represent an edge in the graph.
+     * The flow is only valid while flowStamp matches the network's flowEpoch, so clearing all flows is O(1). Likewise,
+     * the edge is only on the current minimum cost DAG while dagStamp matches dagEpoch. The node of dest is cached in
+     * to by target(), so searches don't look names up; it is reset whenever the edge is copied to another network.
+     * The origin is the node whose adjacency list holds the edge. When the capacity is shared between directions, twin
+     * caches the edge of the same segment the other way, linked by linkTwins(). The name of dest is interned by the
+     * network (see intern()), so the edges into a station all share one string.
      */
     struct Edge {
-        std::string origin;
-        std::string dest;
+        const std::string* dest;
         SegmentType type;
-        const unsigned capacity;
+        unsigned capacity;
         unsigned flow;
-        bool active;
+        unsigned flowStamp;
+        unsigned dagStamp;
+        Node* to;
+        Edge* twin;
         /**
          * @brief Constructs an Edge object with the given parameters.
-         * @param origin The name of the origin node of the edge.
-         * @param dest The name of the destination node of the edge.
+         * @param dest The name of the destination node of the edge, interned by the network it is added to.
          * @param type The type of the segment of the edge.
          * @param capacity The capacity of the edge.
          */
-        Edge(std::string origin, std::string dest, SegmentType type, unsigned capacity) :
-            origin(std::move(origin)),
-            dest(std::move(dest)),
+        Edge(const std::string* dest, SegmentType type, unsigned capacity) :
+            dest(dest),
             type(type),
             capacity(capacity),
-            active(true),
-            flow(0) {}
+            flow(0),
+            flowStamp(0),
+            dagStamp(0),
+            to(nullptr),
+            twin(nullptr) {}
     };
     /**
      * @brief A struct to represent a node in the graph.
+     * The traversal state (indexed by SegmentType) is only valid while its stamp matches the network's epoch of the
+     * same kind, so clearing it for all nodes is O(1) and only the nodes a search touches are ever written.
      */
     struct Node {
         std::string name;
         std::list<Edge> adj;
-        std::string prev;
-        std::string prevStandard;
-        std::string prevAlfa;
-        bool visited;
-        bool visitedStandard;
-        bool visitedAlfa;
+        std::pair<Node*, Edge*> prev[3]; // The node a train of each type came from, and the edge it took
+        unsigned prevStamp[3];
+        unsigned visitedStamp[3];
         unsigned cost;
-        bool active;
+        unsigned costStamp;
         /**
          * @brief Constructs a Node object with the given parameters.
          * @param name The name of the node.
@@ -64,23 +88,49 @@ class RailNetwork { // Directed Graph
         Node(std::string name, std::list<Edge> adj) :
             name(std::move(name)),
             adj(std::move(adj)),
-            prev(""),
-            prevStandard(""),
-            prevAlfa(""),
-            visited(false),
-            visitedStandard(false),
-            visitedAlfa(false),
-            active(true),
-            cost(UINT_MAX){}
+            prev{},
+            prevStamp{0, 0, 0},
+            visitedStamp{0, 0, 0},
+            cost(UINT_MAX),
+            costStamp(0) {}
     };
 
     std::unordered_map<std::string, Node> nodes;
+    // The names the edges point to, by name. Copies of a network share the strings, which live as long as any of them.
+    std::unordered_map<std::string_view, std::shared_ptr<const std::string>> names;
+    unsigned visitEpoch = 1;
+    unsigned prevEpoch = 1;
+    unsigned costEpoch = 1;
+    unsigned flowEpoch = 1;
+    unsigned dagEpoch = 1;
+    CapacityPolicy capacityPolicy = PER_DIRECTION;
+    bool twinsLinked = false; // Whether every edge's twin is up to date
+    /**
+     * @brief The network by dense ids, laid out for the reachability sweeps of cutBound. Capacities and flows are read
+     * through the edges, so only adding or removing nodes and edges drops it.
+     */
+    struct ArcLayout {
+        std::unordered_map<const Node*, unsigned> ids; // Of every node but the super source
+        std::vector<std::pair<unsigned, unsigned>> arcs;
+        std::vector<const Edge*> arcEdges; // The edge of each arc
+        Frontier frontier;
+    };
+    std::unique_ptr<const ArcLayout> layout; // Built on first use. Points into the nodes, so copies build their own.
+    // Only built for the loaded network, empty on sub-networks. Copies of the network share them until either is edited.
+    CopyOnWrite<BlockIndex> blockIndex;
+    CopyOnWrite<ComponentIndex> components;
     /**
      * @brief Gets the node with the given name from the nodes map.
      * @param station The name of the node.
      * @return A reference to the node.
      */
     Node& getNode(const std::string& station);
+    /**
+     * @brief Returns the network's string for a name, adding it if it is new. Edges point to it as their dest.
+     * @param name The name.
+     * @return The interned name, valid as long as the network (or a copy of it) lives.
+     */
+    const std::string* intern(const std::string& name);
     /**
      * @brief Gets the edge between the two given nodes.
      * @param src The name of the source node of the edge.
@@ -88,6 +138,16 @@ class RailNetwork { // Directed Graph
      * @return A reference to the edge.
      */
     Edge& getEdge(const std::string& src, const std::string& dest);
+    /**
+     * @brief Returns the node an edge leads to, caching it in the edge.
+     * @param edge The edge.
+     * @return A reference to the node.
+     */
+    Node& target(Edge& edge);
+    /**
+     * @brief Drops every cached node of the edges and the prevs, which point to the network this one was copied from.
+     */
+    void unlink();
     /**
      * @brief Marks the node with the given name as visited.
      * @param station The name of the node to mark as visited.
@@ -102,21 +162,70 @@ class RailNetwork { // Directed Graph
      */
     bool isVisited(const std::string &station, SegmentType type = INVALID);
     /**
-     * @brief Marks all nodes as not visited.
+     * @brief Returns if given node is visited.
+     * @param node The node.
+     * @param type The type of train.
+     * @return is Node visited?
+     */
+    bool isVisited(const Node& node, SegmentType type) const;
+    /**
+     * @brief Marks all nodes as not visited (starts a new visit epoch).
      */
     void clearVisits();
     /**
-     * @brief Clears prev variables.
+     * @brief Clears prev variables (starts a new prev epoch).
      */
     void clearPrevs();
     /**
-     * @brief Clears the flow of all edges in the graph.
+     * @brief Clears the flow of all edges in the graph (starts a new flow epoch).
      */
     void clearFlow();
     /**
-     * @brief Clears the cost values for all nodes in the graph.
+     * @brief Clears the cost values for all nodes in the graph (starts a new cost epoch).
      */
     void clearCost();
+    /**
+     * @brief Takes every edge out of the minimum cost DAG (starts a new DAG epoch).
+     */
+    void clearDAG();
+    /**
+     * @brief Returns if an edge is on the minimum cost DAG of the last minCostDAG call.
+     * @param edge The edge.
+     * @return Is the edge on a minimum cost path?
+     */
+    bool inDAG(const Edge& edge) const;
+    /**
+     * @brief Returns the flow of an edge in the current flow epoch. When the capacity is shared between directions,
+     * this is the capacity used by the flow both ways.
+     * @param edge The edge.
+     * @return The flow of the edge.
+     */
+    unsigned getFlow(const Edge& edge) const;
+    /**
+     * @brief Adds flow to an edge in the current flow epoch, and to its twin when they share the capacity.
+     * @param edge The edge.
+     * @param flow The flow to add.
+     */
+    void addFlow(Edge& edge, unsigned flow);
+    /**
+     * @brief Takes flow added in the current flow epoch back out of an edge, and out of its twin when they share the
+     * capacity.
+     * @param edge The edge.
+     * @param flow The flow to take out.
+     * @throws std::logic_error If the edge carries less flow than that in the current epoch.
+     */
+    void subtractFlow(Edge& edge, unsigned flow);
+    /**
+     * @brief Links every edge to the edge of the same segment the other way, if there is one.
+     */
+    void linkTwins();
+    /**
+     * @brief Returns the previous node of a node in the current prev epoch, and the edge from it.
+     * @param node The node.
+     * @param type The type of train.
+     * @return The previous node and the edge, or null pointers if there is none.
+     */
+    std::pair<Node*, Edge*> getPrev(const Node& node, SegmentType type) const;
     /**
      * @brief Sets the cost of the node with the given name.
      * @param node The name of the node to set the cost for.
@@ -124,11 +233,13 @@ class RailNetwork { // Directed Graph
      */
     void setCost(const std::string& node, unsigned cost);
     /**
-     * @brief Sets the previous node for the node with the given name.
-     * @param node The name of the node to set the previous node for.
-     * @param prev The name of the previous node.
+     * @brief Sets the previous node of a node, and the edge from it.
+     * @param node The node to set the previous node for.
+     * @param prev The previous node.
+     * @param edge The edge from the previous node.
+     * @param type The type of train.
      */
-    void setPrev(const std::string& node, const std::string& prev, SegmentType type);
+    void setPrev(Node& node, Node& prev, Edge& edge, SegmentType type);
     /**
      * @brief Returns the cost of the node with the given name.
      * @param node The name of the node to return the cost for.
@@ -147,27 +258,58 @@ class RailNetwork { // Directed Graph
      * @param edge The edge to add.
      */
     void addEdge(const std::string& node, const Edge& edge);
+    /**
+     * @brief Removes the edge between two nodes, if there is one.
+     * @param node The name of the origin node of the edge.
+     * @param dest The name of the destination node of the edge.
+     * @return False if there was no such edge.
+     */
+    bool removeEdge(const std::string& node, const std::string& dest);
+    /**
+     * @brief Removes a node with its edges and every edge leading to it.
+     * @param name The name of the node.
+     */
+    void removeNode(const std::string& name);
+    struct PathGraph; // How typedPath (see PathSearch.h) walks the nodes
+    /**
+     * @brief Uses Breadth-First Search to find the shortest path from the given source to destination node, following
+     * only the edges the filter allows. Trains keep their service type along the path (see typedPath).
+     * @tparam F bool(const Node& from, const Edge& edge)
+     * @param src The name of the source node.
+     * @param dest The name of the destination node.
+     * @param usable The filter.
+     * @return The edges of the path, in order.
+     */
+    template<class F>
+    std::vector<Edge*> BFSPath(const std::string& src, const std::string& dest, F usable);
     /**
      * @brief Uses Breadth-First Search to find the path with maximum flow from the given source to destination node.
      * @param src The name of the source node.
      * @param dest The name of the destination node.
-     * @return A list of node names representing the path with maximum flow.
+     * @param minResidual Only segments with at least this much capacity left are followed.
+     * @return The edges of the path, in order.
      */
-    std::list<std::string> BFSFlow(const std::string& src, const std::string& dest);
+    std::vector<Edge*> BFSFlow(const std::string& src, const std::string& dest, unsigned minResidual = 1);
     /**
-     * @brief Uses Breadth-First Search to find all paths with minimum cost from the given source to destination node.
+     * @brief Uses Dijkstra's algorithm to mark every edge on a path with minimum cost from the given source to
+     * destination node, without listing the paths (there can be exponentially many). The marked edges form a DAG,
+     * checked with inDAG, and the cost of each of its nodes is left in the cost epoch.
      * @param src The name of the source node.
      * @param dest The name of the destination node.
-     * @return A list of lists of node names representing all paths with minimum cost.
+     * @param paths If not null, set to the number of paths with minimum cost, counted over the DAG (ULLONG_MAX if
+     * there are more).
+     * @return The nodes of the DAG by increasing cost, empty if the destination can't be reached.
      */
-    std::list<std::list<std::string>> BFSCost(const std::string &src, const std::string &dest);
+    std::vector<Node*> minCostDAG(const std::string &src, const std::string &dest, unsigned long long* paths = nullptr);
     /**
-     * @brief Uses Breadth-First Search to find the shortest path from the given source to destination node, considering only active edges.
+     * @brief Uses Breadth-First Search to find the shortest path from the given source to destination node, considering only
+     * the stations and segments in service in the given scenario.
      * @param src The name of the source node.
      * @param dest The name of the destination node.
-     * @return A list of node names representing the shortest path.
+     * @param scenario The stations and segments out of service.
+     * @return The edges of the shortest path, in order.
      */
-    std::list<std::string> BFSActive(const std::string &src, const std::string &dest);
+    std::vector<Edge*> BFSActive(const std::string &src, const std::string &dest, const Scenario& scenario);
     /**
      * Returns a list of all nodes that are at a specified distance from the source node.
      * @param src The name of the source node.
@@ -175,7 +317,129 @@ class RailNetwork { // Directed Graph
      * @return A list of all nodes at the specified distance from the source node.
      */
     std::list<std::string> distancedNodes(const std::string& src, unsigned distance);
+    /**
+     * Returns, for every node, the same list as distancedNodes(node, 2), built in one pass over the adjacency lists
+     * instead of one BFS (and one copy of every visited adjacency list) per node.
+     * @return A map of node names to the nodes at distance two from them.
+     */
+    std::unordered_map<std::string, std::list<std::string>> distanceTwoNodes();
+    /**
+     * @brief Visits every node reachable from the given one that wasn't visited yet, with Breadth-First Search.
+     * @param source The node to start from, not visited yet.
+     * @return The nodes visited, in order (so the last one is among the farthest from the source).
+     */
+    std::vector<Node*> BFSOrder(Node& source);
+    /**
+     * Calculates the maximum flow that arrives at a station from a super source linked to the given nodes.
+     * The super source node is reused if it already exists, so the caller is responsible for erasing it.
+     * @param station The name of the station.
+     * @param sources The nodes linked to the super source.
+     * @return The maximum flow that arrives at the station.
+     */
+    unsigned superSourceFlow(const std::string& station, const std::list<std::string>& sources);
+    /**
+     * @brief The pairs of an all-pairs search, shared by the workers that solve them.
+     */
+    struct PairSearch;
+    /**
+     * @brief Finds the maximum flow over all ordered pairs of distinct nodes, without solving the pairs that can't reach it.
+     * Each pair is bounded by min(outgoing capacity of the origin, incoming capacity of the destination) and by the cuts
+     * left by the pairs already solved. Pairs are solved from the largest bound down, so the best flow is found early and
+     * the remaining pairs are skipped as soon as their bound falls below it.
+     * @param pairs If not null, set to every pair that reaches the maximum flow, ordered by origin then destination
+     * capacity (as if all pairs were solved in that order).
+     * @param control Stops the search early, returning the best flow so far.
+     * @param reportProgress Whether to report the pairs solved or skipped through control.
+     * @param workers The number of threads solving pairs, each on its own copy of the network.
+     * @return The maximum flow between any two nodes.
+     */
+    unsigned allPairsMaxFlow(std::list<std::pair<std::string, std::string>>* pairs, const Cancellation& control, bool reportProgress, unsigned workers = 1);
+    /**
+     * @brief Ranks regions by the maximum flow between any two of their nodes, searching them on all cores.
+     * Regions are started from the largest, and workers with no region left to start help with the started ones, so
+     * the time taken isn't bounded by the largest region running on one core. A worker copies a region once, the first
+     * time it works on it, and drops the copy once the region is done.
+     * @param k The number of regions to return.
+     * @param regions The network of each region, by name.
+     * @param control Stops the search early, ranking only the regions started so far. Progress is reported per region.
+     * @param workers The number of workers (0 for one per hardware thread). The ranking is the same for any number.
+     * @return The k regions with the largest flows, ranked by flow then name.
+     */
+    static std::list<std::pair<std::string, unsigned>> topRegions(int k, const std::unordered_map<std::string, RailNetwork>& regions, const Cancellation& control, unsigned workers = 0);
+    /**
+     * @brief Builds the network of each value of a station attribute: its stations and the segments between them.
+     * @param index The index of the stations of each value, all of them nodes of this network.
+     * @param attribute The attribute the stations are grouped by.
+     * @return The network of each value.
+     */
+    std::unordered_map<std::string, RailNetwork> groupNetworks(const StationIndex& index, StationAttribute attribute);
+    /**
+     * @brief Builds the network of a railway line: its stations, the junctions next to them (stations of other lines),
+     * and the segments with at least one end on the line, so its trains can cross the junctions.
+     * @param index The index of the stations of each line, all of them nodes of this network.
+     * @param line The name of the line.
+     * @return The network of the line.
+     */
+    RailNetwork lineNetwork(const StationIndex& index, const std::string& line);
+    /**
+     * @brief Sends flow from the origin to the destination by capacity scaling: each phase only uses paths that can
+     * carry at least delta trains, starting from the largest power of two below the biggest capacity and halving it.
+     * @param origin The name of the origin node.
+     * @param destination The name of the destination node.
+     * @param phases The number of phases to run (fewer if delta reaches 1 first).
+     * @return The flow sent, a lower bound of the maximum flow.
+     */
+    unsigned scaledFlow(const std::string& origin, const std::string& destination, unsigned phases);
+    /**
+     * @brief Bounds the maximum flow by the capacity of a cut left by the current flow. The cut is the set of nodes still
+     * reachable from the origin through unsaturated segments or, if it holds the destination, the set of nodes that still
+     * reach the destination. If neither separates them, the capacity around the origin and destination is used.
+     * @param origin The name of the origin node.
+     * @param destination The name of the destination node.
+     * @return An upper bound of the maximum flow.
+     */
+    unsigned cutBound(const std::string& origin, const std::string& destination);
+    /**
+     * @brief Returns the layout of the network by dense ids, building it if an edit dropped it.
+     * @return The layout.
+     */
+    const ArcLayout& arcLayout();
+    /**
+     * @brief Sends the bottleneck of a path along it.
+     * @param path The edges of the path.
+     * @return The flow sent.
+     */
+    unsigned augment(const std::vector<Edge*>& path);
+    /**
+     * @brief Finds how much more flow an upgrade of a segment lets through, on top of the current flow between two nodes
+     * (the blocking flow the augmenting paths left, which there are no reverse edges to undo, so it may not be maximal):
+     * the capacity is raised both ways and the flow augmented from where it stands, then both are restored.
+     * @param origin The name of the origin node of the current flow.
+     * @param destination The name of the destination node of the current flow.
+     * @param stationA The name of a station of the segment.
+     * @param stationB The name of the other station of the segment.
+     * @param extra The capacity added to the segment.
+     * @return The extra flow.
+     */
+    unsigned upgradeGain(const std::string& origin, const std::string& destination, const std::string& stationA, const std::string& stationB, unsigned extra);
 public:
+    /**
+     * @brief Default constructor. Creates an empty network.
+     */
+    RailNetwork() = default;
+    /**
+     * @brief Copies a network, e.g. into a workspace for another thread.
+     * @param other The network to copy.
+     */
+    RailNetwork(const RailNetwork& other);
+    RailNetwork(RailNetwork&& other) = default;
+    /**
+     * @brief Copies a network.
+     * @param other The network to copy.
+     * @return This network.
+     */
+    RailNetwork& operator=(const RailNetwork& other);
+    RailNetwork& operator=(RailNetwork&& other) = default;
     /**
      * Adds a node with the specified name and list of adjacent edges to the rail network.
      * @param name The name of the node to be added.
@@ -186,59 +450,136 @@ public:
      * Calculates and returns the maximum flow between two nodes in the rail network using the Ford-Fulkerson algorithm.
      * @param origin The name of the origin node.
      * @param destination The name of the destination node.
+     * @param control Stops the augmentations early (the flow found so far is still a valid lower bound).
      * @return The maximum flow between the origin and destination nodes.
      */
-    unsigned maxFlow(const std::string& origin, const std::string& destination);
+    unsigned maxFlow(const std::string& origin, const std::string& destination, const Cancellation& control = Cancellation::none());
     /**
      * Returns a list of all important stations in the rail network. Importance is based on the number of paths that pass through the station.
+     * @param control Stops the search early, returning the best pairs so far. Progress is reported per origin station.
      * @return A pair of the list of all important stations in the rail network and the maxFlow between them.
      */
-    std::pair<std::list<std::pair<std::string, std::string>>, unsigned> importantStations();
+    std::pair<std::list<std::pair<std::string, std::string>>, unsigned> importantStations(const Cancellation& control = Cancellation::none());
     /**
-     * Returns a list of the top k municipalities in the rail network based on the number of stations within their borders.
-     * @param k The number of top municipalities to return.
-     * @param stations An unordered map of station names to station objects.
-     * @return A list of the top k municipalities in the rail network.
+     * Returns a list of the top k groups of stations (e.g. municipalities or districts) in the rail network, ranked by
+     * the maximum flow between any two stations of the group using only the segments inside it.
+     * @param k The number of top groups to return.
+     * @param index The index of the stations of each group, all of them nodes of the network.
+     * @param attribute The attribute the stations are grouped by.
+     * @param control Stops the search early, ranking only the groups so far. Progress is reported per group.
+     * @param workers The number of workers (0 for one per hardware thread).
+     * @return A list of the top k groups in the rail network.
      */
-    std::list<std::pair<std::string, unsigned>> topMunicipalities(int k, const std::unordered_map<std::string, Station>& stations);
+    std::list<std::pair<std::string, unsigned>> topGroups(int k, const StationIndex& index, StationAttribute attribute, const Cancellation& control = Cancellation::none(), unsigned workers = 0);
     /**
-     * Returns a list of the top k districts in the rail network based on the number of stations within their borders.
-     * @param k The number of top districts to return.
-     * @param stations An unordered map of station names to station objects.
-     * @return A list of the top k districts in the rail network.
+     * Reports the end to end flow and bottlenecks of every piece of every railway line, and its transfers, each line on
+     * its own network (see lineNetwork). The lines are evaluated in parallel, largest first.
+     * @param index The index of the stations of each line, all of them nodes of the rail network.
+     * @return The report of each line, by line name.
      */
-    std::list<std::pair<std::string, unsigned>> topDistricts(int k, const std::unordered_map<std::string, Station>& stations);
+    std::vector<LineReport> lineReports(const StationIndex& index);
     /**
      * Calculates and returns the maximum flow that passes through a specific station in the rail network.
      * @param station The name of the station.
      * @return The maximum flow that passes through the station.
      */
     unsigned maxFlowStation(const std::string& station);
+    /**
+     * Estimates the maximum flow between two nodes with a few capacity scaling phases, much faster than maxFlow on
+     * large networks, and certifies the estimate with a cut.
+     * @param origin The name of the origin node.
+     * @param destination The name of the destination node.
+     * @param phases The number of capacity scaling phases (more phases give tighter bounds).
+     * @return A lower and an upper bound of the maximum flow.
+     */
+    FlowBounds maxFlowApprox(const std::string& origin, const std::string& destination, unsigned phases);
+    /**
+     * Estimates the maximum flow that passes through a specific station like maxFlowApprox.
+     * @param station The name of the station.
+     * @param phases The number of capacity scaling phases (more phases give tighter bounds).
+     * @return A lower and an upper bound of the maximum flow through the station.
+     */
+    FlowBounds maxFlowStationApprox(const std::string& station, unsigned phases);
+    /**
+     * Calculates maxFlowStation for every station, in parallel, each worker on its own copy of the network.
+     * @param onResult Called as soon as each station finishes (calls are serialized, order is not).
+     * @return A list of all stations and their max flow, ranked by flow.
+     */
+    std::list<std::pair<std::string, unsigned>> stationsFlowReport(const std::function<void(const std::string&, unsigned)>& onResult = nullptr);
     /**
      * Calculates and returns the maximum flow between two nodes in the rail network using the Ford-Fulkerson algorithm with minimum cost.
      * @param origin The name of the origin node.
      * @param destination The name of the destination node.
+     * @param paths If not null, set to the number of paths with minimum cost (ULLONG_MAX if there are more).
      * @return The maximum flow between the origin and destination nodes with minimum cost.
      */
-    unsigned maxFlowMinCost(const std::string& origin, const std::string& destination);
+    unsigned maxFlowMinCost(const std::string& origin, const std::string& destination, unsigned long long* paths = nullptr);
     /**
      * Calculates and returns the maximum flow between two nodes in the rail network using the reduced-cost augmenting path algorithm.
      * @param origin The name of the origin node.
      * @param destination The name of the destination node.
+     * @param scenario The stations and segments out of service.
+     * @param control Stops the augmentations early (the flow found so far is still a valid lower bound).
      * @return The maximum flow between the origin and destination nodes.
      */
-    unsigned maxFlowReduced(const std::string& origin, const std::string& destination);
+    unsigned maxFlowReduced(const std::string& origin, const std::string& destination, const Scenario& scenario, const Cancellation& control = Cancellation::none());
+    /**
+     * Calculates the maximum flow between two nodes under each of the given scenarios, in parallel, each worker on its
+     * own copy of the network.
+     * @param origin The name of the origin node.
+     * @param destination The name of the destination node.
+     * @param scenarios The scenarios to evaluate.
+     * @return The maximum flow under each scenario, in the same order.
+     */
+    std::vector<unsigned> maxFlowScenarios(const std::string& origin, const std::string& destination, const std::vector<Scenario>& scenarios);
+    /**
+     * Ranks the segments whose upgrade would raise the maximum flow between some pairs of nodes the most. Only the
+     * segments of the minimum cut of each pair are candidates for it, and each is tried by augmenting the pair's flow
+     * again after raising its capacity, instead of solving the flow from scratch. Candidates are spread across all
+     * cores, each worker on its own copy of the network.
+     * @param pairs The origin and destination of each pair.
+     * @param extra The capacity an upgrade adds to a segment, both ways.
+     * @param k The number of segments to return.
+     * @return The k segments with the largest gains (only those with any), and the flow they add over all pairs.
+     */
+    std::list<std::pair<Segment, unsigned>> rankUpgrades(const std::list<std::pair<std::string, std::string>>& pairs, unsigned extra, int k);
     /**
      * Returns a list of the top k affected stations, i.e. stations with the highest total flow of passengers
      * in both directions during the day.
      * @param k The number of stations to return.
      * @param stations The map of stations.
+     * @param scenario The stations and segments out of service.
+     * @param control Stops the search early, ranking only the stations so far. Progress is reported per station.
      * @return A list of the names of the top k affected stations.
      */
-    std::list<std::pair<std::string, unsigned>> topAffectedStations(int k,  const std::unordered_map<std::string, Station>& stations );
+    std::list<std::pair<std::string, unsigned>> topAffectedStations(int k,  const std::unordered_map<std::string, Station>& stations, const Scenario& scenario, const Cancellation& control = Cancellation::none());
+    /**
+     * Samples random failures of segments and stations and calculates the max flow between two nodes for each sample,
+     * spreading the samples across all cores. Samples are drawn in fixed blocks, each with its own random stream
+     * seeded from (seed, block), so the result doesn't depend on the number of cores.
+     * @param origin The name of the origin node.
+     * @param destination The name of the destination node.
+     * @param model The failure probability of each segment and station.
+     * @param samples The number of failure scenarios to sample.
+     * @param seed The seed of the random streams.
+     * @return The distribution of the max flow over all samples.
+     */
+    ReliabilityReport simulateFailures(const std::string& origin, const std::string& destination, const FailureModel& model, unsigned long long samples, unsigned seed);
+    /**
+     * Returns the minimum cut of the last maxFlow or maxFlowReduced query, read from the final residual graph.
+     * The last augmenting path search of those queries finds no path, so it leaves exactly the source side visited
+     * and no extra search is needed. Must be called before any other query on this network.
+     * @return The source side of the cut and the saturated segments leaving it.
+     */
+    MinCut lastMinCut();
 
     friend class RailManager;
     friend class App;
+    friend class Checks;
+    friend class ContractedNetwork;
+    friend class BlockIndex;
+    friend class ComponentIndex;
+    friend class NetworkImage;
 };
 
 
@@ -0,0 +1,84 @@
+#ifndef RAILNETWORK_RELIABILITY_H
+#define RAILNETWORK_RELIABILITY_H
+
+#include <cmath>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief Probabilities of each element of the network failing, used to sample random failure scenarios.
+ * Elements without an entry fail with the default probability of their kind.
+ * A failed segment is unusable in both directions.
+ */
+struct FailureModel {
+    double segmentProbability = 0;
+    double stationProbability = 0;
+    std::unordered_map<std::string, std::unordered_map<std::string, double>> segments;
+    std::unordered_map<std::string, double> stations;
+    /**
+     * @brief Gets the failure probability of the segment between two stations (in either direction).
+     * @param stationA The name of one of the stations.
+     * @param stationB The name of the other station.
+     * @return The failure probability of the segment.
+     */
+    double segmentFailure(const std::string& stationA, const std::string& stationB) const {
+        for (const auto& [a, b] : {std::make_pair(&stationA, &stationB), std::make_pair(&stationB, &stationA)}) {
+            auto it = segments.find(*a);
+            if (it == segments.end()) continue;
+            auto it2 = it->second.find(*b);
+            if (it2 != it->second.end()) return it2->second;
+        }
+        return segmentProbability;
+    }
+    /**
+     * @brief Gets the failure probability of a station.
+     * @param station The name of the station.
+     * @return The failure probability of the station.
+     */
+    double stationFailure(const std::string& station) const {
+        auto it = stations.find(station);
+        return it == stations.end() ? stationProbability : it->second;
+    }
+};
+
+/**
+ * @brief Distribution of the max flow between two stations over many sampled failure scenarios.
+ */
+struct ReliabilityReport {
+    unsigned long long samples = 0;
+    unsigned intactFlow = 0;
+    std::map<unsigned, unsigned long long> distribution;
+    /**
+     * @brief Mean max flow over all samples.
+     */
+    double mean() const {
+        if (samples == 0) return 0;
+        double sum = 0;
+        for (const auto& [flow, count] : distribution) sum += (double) flow * (double) count;
+        return sum / (double) samples;
+    }
+    /**
+     * @brief Max flow below or at which the given percentage of the samples falls (nearest rank).
+     * @param p The percentage, between 0 and 100.
+     */
+    unsigned percentile(double p) const {
+        if (distribution.empty()) return 0;
+        auto rank = (unsigned long long) std::ceil(p / 100.0 * (double) samples);
+        if (rank == 0) rank = 1;
+        unsigned long long seen = 0;
+        for (const auto& [flow, count] : distribution)
+            if ((seen += count) >= rank) return flow;
+        return distribution.rbegin()->first;
+    }
+    /**
+     * @brief Fraction of the samples in which the two stations were disconnected.
+     */
+    double disconnectedProbability() const {
+        auto it = distribution.find(0);
+        return (it == distribution.end() || samples == 0) ? 0 : (double) it->second / (double) samples;
+    }
+};
+
+
+#endif //RAILNETWORK_RELIABILITY_H
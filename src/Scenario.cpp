@@ -0,0 +1,44 @@
+#include "Scenario.h"
+
+using namespace std;
+
+
+Scenario::Scenario(const list<pair<string, string>> &segments, const list<string> &stations) {
+    for (const auto& [origin, destination] : segments)
+        this->segments[origin].insert(destination);
+    this->stations.insert(stations.begin(), stations.end());
+}
+
+Scenario Scenario::withStation(const string &station) const {
+    Scenario res = *this;
+    res.stations.insert(station);
+    return res;
+}
+
+Scenario Scenario::withSegment(const string &origin, const string &destination) const {
+    Scenario res = *this;
+    res.segments[origin].insert(destination);
+    return res;
+}
+
+bool Scenario::stationDisabled(const string &station) const {
+    return stations.find(station) != stations.end();
+}
+
+bool Scenario::segmentDisabled(const string &origin, const string &destination) const {
+    auto it = segments.find(origin);
+    return it != segments.end() && it->second.find(destination) != it->second.end();
+}
+
+bool Scenario::empty() const {
+    return stations.empty() && segments.empty();
+}
+
+list<string> Scenario::namedStations() const {
+    list<string> res(stations.begin(), stations.end());
+    for (const auto& [origin, destinations] : segments) {
+        res.push_back(origin);
+        res.insert(res.end(), destinations.begin(), destinations.end());
+    }
+    return res;
+}
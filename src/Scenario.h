@@ -0,0 +1,70 @@
+#ifndef RAILNETWORK_SCENARIO_H
+#define RAILNETWORK_SCENARIO_H
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+/**
+ * @brief An immutable failure scenario: the stations and segments that are out of service.
+ * Queries take a scenario as a parameter instead of deactivating parts of the shared network, so any number of
+ * scenarios can exist (and be evaluated) at the same time. Building or deriving a scenario costs O(size of scenario).
+ */
+class Scenario {
+    std::unordered_set<std::string> stations;
+    std::unordered_map<std::string, std::unordered_set<std::string>> segments;
+    friend class BlockIndex;
+    friend class ComponentIndex;
+public:
+    /**
+     * @brief Default constructor. Creates a scenario where everything is in service.
+     */
+    Scenario() = default;
+    /**
+     * @brief Constructs a scenario with the given segments and stations out of service.
+     * @param segments A list of pairs of stations that represent the (directed) segments out of service.
+     * @param stations A list of names of stations out of service.
+     */
+    Scenario(const std::list<std::pair<std::string, std::string>>& segments, const std::list<std::string>& stations);
+    /**
+     * @brief Returns a copy of this scenario with one more station out of service.
+     * @param station The name of the station.
+     * @return The new scenario.
+     */
+    Scenario withStation(const std::string& station) const;
+    /**
+     * @brief Returns a copy of this scenario with one more (directed) segment out of service.
+     * @param origin The name of the origin station.
+     * @param destination The name of the destination station.
+     * @return The new scenario.
+     */
+    Scenario withSegment(const std::string& origin, const std::string& destination) const;
+    /**
+     * @brief Checks if a station is out of service.
+     * @param station The name of the station.
+     * @return True if the station is out of service, false otherwise.
+     */
+    bool stationDisabled(const std::string& station) const;
+    /**
+     * @brief Checks if a segment is out of service.
+     * @param origin The name of the origin station.
+     * @param destination The name of the destination station.
+     * @return True if the segment is out of service, false otherwise.
+     */
+    bool segmentDisabled(const std::string& origin, const std::string& destination) const;
+    /**
+     * @brief Checks if everything is in service.
+     * @return True if no station nor segment is out of service.
+     */
+    bool empty() const;
+    /**
+     * @brief Returns every station the scenario names: the stations out of service and the ends of the segments out of service.
+     * @return The names of the stations, possibly repeated.
+     */
+    std::list<std::string> namedStations() const;
+};
+
+
+#endif //RAILNETWORK_SCENARIO_H
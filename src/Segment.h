@@ -12,6 +12,15 @@ enum SegmentType {
     ALFA_PENDULAR
 };
 
+/**
+ * @brief How the capacity of a segment is split between its two directions: each direction gets the full capacity
+ * (double track), or both share it (single track), so trains one way leave less room for trains the other way.
+ */
+enum CapacityPolicy {
+    PER_DIRECTION,
+    SHARED
+};
+
 /**
  * @brief Represents a segment of a railway network connecting two stations.
  */
@@ -0,0 +1,544 @@
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include <list>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "Server.h"
+#include "Parallel.h"
+
+using namespace std;
+
+
+Server::Server(const string& datasetPath, string socketPath, unsigned workers, size_t queueCapacity) :
+        socketPath(std::move(socketPath)),
+        workers(workers == 0 ? Parallel::workerCount(SIZE_MAX) : workers),
+        queue(queueCapacity) {
+    string path = datasetPath;
+    if (!path.empty() && path.back() != '/' && path.back() != '\\') path += '/';
+    auto railMan = make_shared<RailManager>();
+    railMan->initializeData(path);
+    railMan->build(); // Before the workers copy it, so they all share the indexes
+    loaded = std::move(railMan);
+}
+
+Server::Server(NetworkImage image, string socketPath, unsigned workers, size_t queueCapacity) :
+        loaded(make_shared<const RailManager>()),
+        image(std::move(image)),
+        socketPath(std::move(socketPath)),
+        workers(workers == 0 ? Parallel::workerCount(SIZE_MAX) : workers),
+        queue(queueCapacity) {}
+
+// []===========================================[] //
+// ||                 REQUESTS                  || //
+// []===========================================[] //
+
+static const string& getStation(RailManager& railMan, const Json& request, const string& key) {
+    const string& name = request[key].asString();
+    if (!railMan.stationExists(name)) throw invalid_argument("Unknown station \"" + name + "\".");
+    return name;
+}
+
+// Numbers arrive as doubles, which are only cast to an integer type within its range (NaN is in no range)
+static double getInteger(const Json& request, const string& key, unsigned long long min, unsigned long long max) {
+    double value = request[key].asNumber();
+    if (!(value >= (double) min && value <= (double) max))
+        throw invalid_argument("\"" + key + "\" must be between " + to_string(min) + " and " + to_string(max) + ".");
+    return value;
+}
+
+static int getK(const Json& request) {
+    return (int) getInteger(request, "k", 1, INT_MAX);
+}
+
+static StationAttribute getAttribute(const Json& request) {
+    const string& attribute = request["attribute"].asString();
+    if (attribute == "district") return DISTRICT;
+    if (attribute == "municipality") return MUNICIPALITY;
+    if (attribute == "township") return TOWNSHIP;
+    if (attribute == "line") return LINE;
+    throw invalid_argument("\"attribute\" must be district, municipality, township or line.");
+}
+
+static list<pair<string, string>> getPairs(RailManager& railMan, const Json& request) {
+    list<pair<string, string>> pairs;
+    if (!request.has("pairs")) {
+        pairs.emplace_back(getStation(railMan, request, "origin"), getStation(railMan, request, "destination"));
+        return pairs;
+    }
+    for (const Json& pair : request["pairs"].items()) {
+        const vector<Json>& ends = pair.items();
+        if (ends.size() != 2) throw invalid_argument("Pairs must be [origin, destination] pairs.");
+        for (const Json& end : ends)
+            if (!railMan.stationExists(end.asString())) throw invalid_argument("Unknown station \"" + end.asString() + "\".");
+        pairs.emplace_back(ends[0].asString(), ends[1].asString());
+    }
+    return pairs;
+}
+
+static unsigned getExtra(const Json& request) {
+    return (unsigned) getInteger(request, "extra", 1, UINT_MAX);
+}
+
+static Scenario getScenario(const Json& request) {
+    list<pair<string, string>> segments;
+    list<string> stations;
+    if (request.has("segments"))
+        for (const Json& segment : request["segments"].items()) {
+            const vector<Json>& ends = segment.items();
+            if (ends.size() != 2) throw invalid_argument("Segments must be [origin, destination] pairs.");
+            segments.emplace_back(ends[0].asString(), ends[1].asString());
+        }
+    if (request.has("stations"))
+        for (const Json& station : request["stations"].items())
+            stations.push_back(station.asString());
+    return {segments, stations};
+}
+
+static Json boundsToJson(const FlowBounds& bounds) {
+    Json res = Json::object();
+    res["lower"] = bounds.lower;
+    res["upper"] = bounds.upper;
+    res["exact"] = bounds.exact();
+    return res;
+}
+
+static unsigned getPhases(const Json& request) {
+    return (unsigned) getInteger(request, "approximate", 1, UINT_MAX);
+}
+
+static Cancellation getTimeout(const Json& request) {
+    if (!request.has("timeoutMs")) return {};
+    double timeout = request["timeoutMs"].asNumber();
+    if (!(timeout > 0 && timeout <= 1e12)) throw invalid_argument("\"timeoutMs\" must be positive and at most 1e12.");
+    return Cancellation(chrono::microseconds((long long) (timeout * 1000)));
+}
+
+static Json partialResult(Json result, const Json& request, const Cancellation& control) {
+    if (!request.has("timeoutMs")) return result;
+    Json res = Json::object();
+    res["partial"] = control.interrupted();
+    res["result"] = std::move(result);
+    return res;
+}
+
+static Json rankingToJson(const list<pair<string, unsigned>>& ranking) {
+    Json res = Json::array();
+    for (const auto& [name, value] : ranking) {
+        Json entry = Json::array();
+        entry.push(name);
+        entry.push(value);
+        res.push(entry);
+    }
+    return res;
+}
+
+static Json segmentToJson(const Segment& segment) {
+    Json res = Json::object();
+    res["origin"] = segment.origin;
+    res["destination"] = segment.destination;
+    res["capacity"] = segment.capacity;
+    res["service"] = segment.service == ALFA_PENDULAR ? "ALFA PENDULAR" : "STANDARD";
+    return res;
+}
+
+static Json flowCutToJson(unsigned flow, const MinCut& cut) {
+    Json res = Json::object();
+    res["flow"] = flow;
+    res["sourceSide"] = Json::array();
+    for (const string& station : cut.sourceSide)
+        res["sourceSide"].push(station);
+    res["segments"] = Json::array();
+    for (const Segment& segment : cut.segments)
+        res["segments"].push(segmentToJson(segment));
+    return res;
+}
+
+static Json lineReportToJson(const LineReport& report) {
+    Json res = Json::object();
+    res["line"] = report.line;
+    res["stations"] = report.stations;
+    res["pieces"] = Json::array();
+    for (const LinePiece& piece : report.pieces) {
+        Json entry = Json::object();
+        entry["stations"] = piece.stations;
+        entry["origin"] = piece.origin;
+        entry["destination"] = piece.destination;
+        entry["flow"] = piece.flow;
+        entry["bottlenecks"] = Json::array();
+        for (const Segment& segment : piece.bottlenecks)
+            entry["bottlenecks"].push(segmentToJson(segment));
+        res["pieces"].push(entry);
+    }
+    res["transfers"] = Json::array();
+    for (const LineTransfer& transfer : report.transfers) {
+        Json entry = Json::object();
+        entry["station"] = transfer.station;
+        entry["line"] = transfer.line;
+        entry["capacity"] = transfer.capacity;
+        res["transfers"].push(entry);
+    }
+    return res;
+}
+
+Json Server::dispatch(RailManager& railMan, const Json& request) {
+    const string& query = request["query"].asString();
+    if (query == "maxFlow" && request.has("approximate"))
+        return boundsToJson(railMan.maxFlowApprox(getStation(railMan, request, "origin"), getStation(railMan, request, "destination"), getPhases(request)));
+    if (query == "maxFlow")
+        return railMan.maxFlow(getStation(railMan, request, "origin"), getStation(railMan, request, "destination"));
+    if (query == "maxFlowCut") {
+        auto [flow, cut] = railMan.maxFlowCut(getStation(railMan, request, "origin"), getStation(railMan, request, "destination"));
+        return flowCutToJson(flow, cut);
+    }
+    if (query == "importantStations") {
+        Cancellation control = getTimeout(request);
+        auto [pairs, flow] = railMan.importantStations(control);
+        Json res = Json::object();
+        res["flow"] = flow;
+        res["pairs"] = Json::array();
+        for (const auto& [stationA, stationB] : pairs) {
+            Json entry = Json::array();
+            entry.push(stationA);
+            entry.push(stationB);
+            res["pairs"].push(entry);
+        }
+        return partialResult(res, request, control);
+    }
+    if (query == "topMunicipalities") {
+        Cancellation control = getTimeout(request);
+        return partialResult(rankingToJson(railMan.topMunicipalities(getK(request), control)), request, control);
+    }
+    if (query == "topDistricts") {
+        Cancellation control = getTimeout(request);
+        return partialResult(rankingToJson(railMan.topDistricts(getK(request), control)), request, control);
+    }
+    if (query == "topK") {
+        Cancellation control = getTimeout(request);
+        return partialResult(rankingToJson(railMan.topK(getAttribute(request), getK(request), control)), request, control);
+    }
+    if (query == "rankUpgrades") {
+        Json res = Json::array();
+        for (const auto& [segment, gain] : railMan.rankUpgrades(getPairs(railMan, request), getExtra(request), getK(request))) {
+            Json entry = segmentToJson(segment);
+            entry["gain"] = gain;
+            res.push(entry);
+        }
+        return res;
+    }
+    if (query == "lineReports") {
+        Json res = Json::array();
+        for (const LineReport& report : railMan.lineReports())
+            res.push(lineReportToJson(report));
+        return res;
+    }
+    if (query == "maxFlowStation" && request.has("approximate"))
+        return boundsToJson(railMan.maxFlowStationApprox(getStation(railMan, request, "station"), getPhases(request)));
+    if (query == "maxFlowStation") return railMan.maxFlowStation(getStation(railMan, request, "station"));
+    if (query == "stationsFlowReport") return rankingToJson(railMan.stationsFlowReport());
+    if (query == "maxFlowMinCost")
+        return railMan.maxFlowMinCost(getStation(railMan, request, "origin"), getStation(railMan, request, "destination"));
+    if (query == "maxFlowReduced")
+        return railMan.maxFlowReduced(getStation(railMan, request, "origin"), getStation(railMan, request, "destination"), getScenario(request));
+    if (query == "maxFlowReducedCut") {
+        auto [flow, cut] = railMan.maxFlowReducedCut(getStation(railMan, request, "origin"), getStation(railMan, request, "destination"), getScenario(request));
+        return flowCutToJson(flow, cut);
+    }
+    if (query == "topAffectedStations") {
+        Cancellation control = getTimeout(request);
+        return partialResult(rankingToJson(railMan.topAffectedStations(getK(request), getScenario(request), control)), request, control);
+    }
+    if (query == "simulateFailures") {
+        FailureModel model;
+        if (request.has("segmentProbability")) model.segmentProbability = request["segmentProbability"].asNumber();
+        if (request.has("stationProbability")) model.stationProbability = request["stationProbability"].asNumber();
+        double samples = getInteger(request, "samples", 1, UINT_MAX);
+        unsigned seed = request.has("seed") ? (unsigned) getInteger(request, "seed", 0, UINT_MAX) : 0;
+        ReliabilityReport report = railMan.simulateFailures(getStation(railMan, request, "origin"), getStation(railMan, request, "destination"), model, (unsigned long long) samples, seed);
+        Json res = Json::object();
+        res["samples"] = report.samples;
+        res["intactFlow"] = report.intactFlow;
+        res["mean"] = report.mean();
+        res["disconnectedProbability"] = report.disconnectedProbability();
+        res["percentiles"] = Json::object();
+        for (int p : {1, 5, 25, 50, 75, 95, 99})
+            res["percentiles"]["p" + to_string(p)] = report.percentile(p);
+        res["distribution"] = Json::array();
+        for (const auto& [flow, count] : report.distribution) {
+            Json entry = Json::array();
+            entry.push(flow);
+            entry.push(count);
+            res["distribution"].push(entry);
+        }
+        return res;
+    }
+    if (query == "station") {
+        const Station& station = railMan.getStation(getStation(railMan, request, "station"));
+        Json res = Json::object();
+        res["name"] = station.name;
+        res["district"] = station.district;
+        res["municipality"] = station.municipality;
+        res["township"] = station.township;
+        res["line"] = station.line;
+        return res;
+    }
+    if (query == "segment") {
+        const string& origin = getStation(railMan, request, "origin");
+        const string& destination = getStation(railMan, request, "destination");
+        if (!railMan.segmentExists(origin, destination)) throw invalid_argument("Unknown segment.");
+        return segmentToJson(railMan.getSegment(origin, destination));
+    }
+    throw invalid_argument("Unknown query \"" + query + "\".");
+}
+
+static uint32_t getStation(const NetworkImage& image, const Json& request, const string& key) {
+    const string& name = request[key].asString();
+    uint32_t id = image.find(name);
+    if (id == UINT32_MAX) throw invalid_argument("Unknown station \"" + name + "\".");
+    return id;
+}
+
+Json Server::dispatch(NetworkImage& image, const Json& request) {
+    const string& query = request["query"].asString();
+    if (query == "maxFlow" && !request.has("approximate"))
+        return image.maxFlow(getStation(image, request, "origin"), getStation(image, request, "destination"));
+    if (query == "station") {
+        const Station station = image.station(getStation(image, request, "station"));
+        Json res = Json::object();
+        res["name"] = station.name;
+        res["district"] = station.district;
+        res["municipality"] = station.municipality;
+        res["township"] = station.township;
+        res["line"] = station.line;
+        return res;
+    }
+    if (query == "segment") {
+        uint32_t origin = getStation(image, request, "origin"), destination = getStation(image, request, "destination");
+        try {
+            return segmentToJson(image.segment(origin, destination));
+        } catch (const out_of_range&) {
+            throw invalid_argument("Unknown segment.");
+        }
+    }
+    throw invalid_argument("Query \"" + query + "\" needs a loaded dataset, this server runs on a network image.");
+}
+
+static unsigned getCapacity(const Json& request) {
+    return (unsigned) getInteger(request, "capacity", 0, UINT_MAX);
+}
+
+bool Server::isEdit(const Json& request) {
+    const string& query = request["query"].asString();
+    return query == "addStation" || query == "removeStation" || query == "addSegment" || query == "removeSegment" ||
+           query == "setCapacity" || query == "setCapacityPolicy";
+}
+
+bool Server::edit(RailManager& railMan, const Json& request) {
+    const string& query = request["query"].asString();
+    if (query == "addStation") {
+        if (!railMan.insertStation(request["name"].asString(), request["district"].asString(), request["municipality"].asString(), request["township"].asString(), request["line"].asString()))
+            throw invalid_argument("The station already exists.");
+        return true;
+    }
+    if (query == "removeStation") {
+        railMan.removeStation(getStation(railMan, request, "station"));
+        return true;
+    }
+    if (query == "addSegment") {
+        const string& service = request["service"].asString();
+        SegmentType type = service == "STANDARD" ? STANDARD : service == "ALFA PENDULAR" ? ALFA_PENDULAR : INVALID;
+        if (type == INVALID) throw invalid_argument("Unknown service \"" + service + "\".");
+        if (!railMan.insertSegment(getStation(railMan, request, "origin"), getStation(railMan, request, "destination"), getCapacity(request), type))
+            throw invalid_argument("The stations are the same or already have a segment.");
+        return true;
+    }
+    if (query == "removeSegment") {
+        if (!railMan.removeSegment(getStation(railMan, request, "origin"), getStation(railMan, request, "destination")))
+            throw invalid_argument("Unknown segment.");
+        return true;
+    }
+    if (query == "setCapacity") {
+        if (!railMan.setSegmentCapacity(getStation(railMan, request, "origin"), getStation(railMan, request, "destination"), getCapacity(request)))
+            throw invalid_argument("Unknown segment.");
+        return true;
+    }
+    if (query == "setCapacityPolicy") {
+        const string& policy = request["policy"].asString();
+        if (policy == "shared") railMan.setCapacityPolicy(SHARED);
+        else if (policy == "perDirection") railMan.setCapacityPolicy(PER_DIRECTION);
+        else throw invalid_argument("\"policy\" must be shared or perDirection.");
+        return true;
+    }
+    return false;
+}
+
+// []===========================================[] //
+// ||                  WORKERS                  || //
+// []===========================================[] //
+
+void Server::catchUp(unsigned worker, RailManager &railMan) {
+    size_t& applied = progress[worker];
+    for (; applied < trimmed + edits.size(); applied++)
+        edit(railMan, edits[applied - trimmed]);
+    const size_t oldest = *min_element(progress.begin(), progress.end());
+    for (; trimmed < oldest; trimmed++)
+        edits.pop_front();
+}
+
+void Server::work(unsigned worker, RailManager& railMan, NetworkImage& image) {
+    Job job;
+    while (queue.pop(job)) {
+        auto start = chrono::steady_clock::now();
+        Json response = Json::object();
+        try {
+            Json request = Json::parse(job.line);
+            if (request.has("id")) response["id"] = request["id"];
+            bool edited = false;
+            // Only this worker writes its progress, so it can be compared to the log without the mutex. An edit is
+            // counted in the log before its response is sent, so a request sent after that response can't miss it.
+            if (!image.attached() && (isEdit(request) || logged != progress[worker])) {
+                lock_guard<mutex> lock(editMutex);
+                catchUp(worker, railMan);
+                edited = edit(railMan, request); // Throws before reaching the log if invalid
+                if (edited) {
+                    edits.push_back(request);
+                    logged++;
+                    progress[worker]++;
+                    catchUp(worker, railMan); // Drops it right away if this is the only worker
+                }
+            }
+            Json result = edited ? Json(true) : image.attached() ? dispatch(image, request) : dispatch(railMan, request);
+            response["ok"] = true;
+            response["result"] = result;
+        } catch (const exception& e) {
+            response["ok"] = false;
+            response["error"] = e.what();
+        }
+        auto end = chrono::steady_clock::now();
+        response["queueMicros"] = (unsigned long long) chrono::duration_cast<chrono::microseconds>(start - job.received).count();
+        response["micros"] = (unsigned long long) chrono::duration_cast<chrono::microseconds>(end - start).count();
+        respond(*job.connection, response);
+        job.connection.reset();
+    }
+}
+
+#ifdef _WIN32
+
+Server::Connection::~Connection() = default;
+
+void Server::respond(Connection&, const Json&) {}
+
+void Server::serve(const shared_ptr<Connection>&) {}
+
+int Server::run() {
+    cerr << "Server mode needs Unix domain sockets, which aren't supported on this platform." << endl;
+    return 1;
+}
+
+#else
+
+Server::Connection::~Connection() {
+    close(fd);
+}
+
+void Server::respond(Connection &connection, const Json &response) {
+    string line = response.dump() + '\n';
+    lock_guard<mutex> lock(connection.writeMutex);
+    size_t sent = 0;
+    while (sent < line.size()) {
+        ssize_t n = send(connection.fd, line.data() + sent, line.size() - sent, 0);
+        if (n <= 0) return; // Client is gone
+        sent += n;
+    }
+}
+
+void Server::serve(const shared_ptr<Connection>& connection) {
+    string pending;
+    char buffer[4096];
+    while (true) {
+        ssize_t n = recv(connection->fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) break;
+        pending.append(buffer, n);
+        size_t start = 0, end;
+        while ((end = pending.find('\n', start)) != string::npos) {
+            string line = pending.substr(start, end - start);
+            start = end + 1;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) continue;
+            // Blocks while the queue is full, so a client sending too fast stops being read
+            if (!queue.push({connection, line, chrono::steady_clock::now()})) return;
+        }
+        pending.erase(0, start);
+        if (pending.size() > maxLineLength) { // Not a request, and reading on would keep all of it
+            Json response = Json::object();
+            response["ok"] = false;
+            response["error"] = "Request longer than " + to_string(maxLineLength) + " bytes.";
+            respond(*connection, response);
+            return;
+        }
+    }
+}
+
+int Server::run() {
+    signal(SIGPIPE, SIG_IGN); // Clients that disconnect early shouldn't kill the server
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (listener < 0 || socketPath.size() >= sizeof(address.sun_path)) {
+        cerr << "Couldn't create the socket " << socketPath << endl;
+        return 1;
+    }
+    socketPath.copy(address.sun_path, socketPath.size());
+    unlink(socketPath.c_str());
+    if (bind(listener, (sockaddr*) &address, sizeof(address)) < 0 || listen(listener, 64) < 0) {
+        cerr << "Couldn't listen on " << socketPath << endl;
+        close(listener);
+        return 1;
+    }
+    progress.assign(workers, 0);
+    vector<thread> pool;
+    for (unsigned w = 0; w < workers; w++)
+        pool.emplace_back([this, w]() {
+            RailManager workspace = *loaded;
+            NetworkImage scratch = image; // Maps the same pages, with its own scratch state
+            work(w, workspace, scratch);
+        });
+    cout << "Listening on " << socketPath << " with " << workers << " workers." << endl;
+    list<Client> clients;
+    while (true) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) break;
+        clients.remove_if([](Client& client) {
+            if (!client.done) return false;
+            client.reader.join();
+            return true;
+        });
+        Client& client = clients.emplace_back();
+        client.connection = make_shared<Connection>(fd);
+        client.reader = thread([this, &client]() {
+            serve(client.connection);
+            client.done = true;
+        });
+    }
+    // Readers waiting for the queue are woken by closing it, and those waiting for their client by shutting its socket
+    queue.close();
+    for (Client& client : clients) {
+        shutdown(client.connection->fd, SHUT_RD);
+        client.reader.join();
+    }
+    for (thread& t : pool) t.join();
+    close(listener);
+    unlink(socketPath.c_str());
+    return 0;
+}
+
+#endif
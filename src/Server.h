@@ -0,0 +1,166 @@
+#ifndef RAILNETWORK_SERVER_H
+#define RAILNETWORK_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Json.h"
+#include "NetworkImage.h"
+#include "RailManager.h"
+#include "WorkQueue.h"
+
+/**
+ * @brief Long-running query server, an alternative to the App TUI for tools.
+ * The dataset is loaded once. Clients connect to a Unix domain socket and send one JSON request per line, e.g.
+ * {"id": 1, "query": "maxFlow", "origin": "Porto Campanhã", "destination": "Lisboa Oriente"}
+ * and get one JSON response per line (in completion order, matched by id) with the result and its timings:
+ * {"id": 1, "ok": true, "result": 4, "queueMicros": 12, "micros": 843}
+ * topK ranks the values of any station "attribute" (district, municipality, township or line) like topDistricts does.
+ * lineReports gives the junction transfers of every railway line and, for each piece of it (a line is split where
+ * another line runs a stretch of it), its stations, terminals, end to end flow and bottleneck segments.
+ * rankUpgrades takes "pairs": [[origin, destination], ...] (or one origin and destination), the "extra" capacity of an
+ * upgrade and "k", and returns the k segments whose upgrade adds the most flow over the pairs, each with its "gain".
+ * The long analyses (importantStations, topMunicipalities, topDistricts, topK, topAffectedStations) accept a "timeoutMs"
+ * and then return {"partial": bool, "result": ...} instead, partial being true if they ran out of time.
+ * maxFlow and maxFlowStation accept "approximate": phases, and then return {"lower", "upper", "exact"} bounds.
+ * Requests are dispatched to a pool of workers. The dataset is loaded and built once and only read afterwards: each
+ * worker copies it into a workspace that shares its stations, segments and indexes, and only owns the graphs its
+ * queries keep their flows and traversal state in. When the queue is full, connections stop being read until a worker
+ * frees a slot. A connection that sends more than maxLineLength bytes without a newline is answered with an error and
+ * no longer read.
+ * Edits (addStation, removeStation, addSegment, removeSegment, setCapacity, setCapacityPolicy) are appended to a log,
+ * which every worker replays on its workspace before its next request, so a query sent after an edit's response always
+ * sees the edit. A workspace gets its own copy of whatever an edit changes. Edits are dropped from the log once every
+ * worker applied them, and a worker only takes the log's mutex for an edit or when the log has edits it hasn't applied.
+ * setCapacityPolicy takes "policy": "shared" (single track) or "perDirection".
+ * A server can instead attach to a network image (see NetworkImage), so every server process on a host shares one
+ * read-only copy of the network and starts without parsing. It then answers maxFlow, station and segment, each worker
+ * keeping its own scratch state, and refuses edits and the other queries.
+ */
+class Server {
+    /**
+     * @brief A client connection. Responses from different workers are written whole under the mutex.
+     */
+    struct Connection {
+        int fd;
+        std::mutex writeMutex;
+        explicit Connection(int fd) : fd(fd) {}
+        ~Connection();
+    };
+    /**
+     * @brief The thread reading a connection, joined once it is done or when the server stops.
+     */
+    struct Client {
+        std::shared_ptr<Connection> connection;
+        std::thread reader;
+        std::atomic<bool> done{false};
+    };
+    /**
+     * @brief A request waiting for a worker.
+     */
+    struct Job {
+        std::shared_ptr<Connection> connection;
+        std::string line;
+        std::chrono::steady_clock::time_point received;
+    };
+    static const size_t maxLineLength = 1 << 20;
+    std::shared_ptr<const RailManager> loaded; // Copied by every worker into its workspace
+    NetworkImage image; // Attached if the server runs on an image instead of a loaded dataset
+    std::string socketPath;
+    unsigned workers;
+    WorkQueue<Job> queue;
+    std::mutex editMutex; // Guards the log and how far each worker got through it
+    std::deque<Json> edits; // The edits some worker hasn't applied yet, in order
+    size_t trimmed = 0; // Edits every worker applied, dropped from the front of the log
+    std::vector<size_t> progress; // Edits each worker applied
+    std::atomic<size_t> logged{0}; // Edits ever logged, read without the mutex to skip it while there is nothing new
+    /**
+     * @brief Runs one request on the given manager.
+     * @param railMan The worker's copy of the rail manager.
+     * @param request The request.
+     * @return The result of the query.
+     * @throws std::exception If the request is invalid or the query fails.
+     */
+    static Json dispatch(RailManager& railMan, const Json& request);
+    /**
+     * @brief Runs one request on the given image.
+     * @param image The worker's copy of the image.
+     * @param request The request.
+     * @return The result of the query.
+     * @throws std::exception If the request is invalid or the query isn't supported on an image.
+     */
+    static Json dispatch(NetworkImage& image, const Json& request);
+    /**
+     * @brief Checks if a request is an edit.
+     * @param request The request.
+     * @return True if it is.
+     */
+    static bool isEdit(const Json& request);
+    /**
+     * @brief Applies an edit request to the given manager.
+     * @param railMan The worker's copy of the rail manager.
+     * @param request The request.
+     * @return False if the request isn't an edit.
+     * @throws std::exception If the edit is invalid.
+     */
+    static bool edit(RailManager& railMan, const Json& request);
+    /**
+     * @brief Applies the edits of the log a worker hasn't applied yet to its workspace, then drops those every worker
+     * applied. Must be called with the edit mutex held.
+     * @param worker The worker.
+     * @param railMan The worker's workspace.
+     */
+    void catchUp(unsigned worker, RailManager& railMan);
+    /**
+     * @brief Pops and runs jobs until the queue is closed.
+     * @param worker The worker.
+     * @param railMan The worker's workspace.
+     * @param image The worker's copy of the image, used instead of the workspace if it is attached.
+     */
+    void work(unsigned worker, RailManager& railMan, NetworkImage& image);
+    /**
+     * @brief Reads the lines of a connection and queues them, until the client disconnects, sends a line longer than
+     * maxLineLength or the server stops.
+     * @param connection The connection.
+     */
+    void serve(const std::shared_ptr<Connection>& connection);
+    /**
+     * @brief Writes a response line to a connection.
+     * @param connection The connection.
+     * @param response The response.
+     */
+    static void respond(Connection& connection, const Json& response);
+public:
+    /**
+     * @brief Loads the dataset and prepares the server.
+     * @param datasetPath The path to the directory containing the CSV files.
+     * @param socketPath The path of the Unix domain socket to listen on.
+     * @param workers The number of workers (0 for one per hardware thread).
+     * @param queueCapacity The maximum number of requests waiting for a worker.
+     */
+    Server(const std::string& datasetPath, std::string socketPath, unsigned workers = 0, size_t queueCapacity = 64);
+    /**
+     * @brief Prepares a server on an attached network image.
+     * @param image The image.
+     * @param socketPath The path of the Unix domain socket to listen on.
+     * @param workers The number of workers (0 for one per hardware thread).
+     * @param queueCapacity The maximum number of requests waiting for a worker.
+     */
+    Server(NetworkImage image, std::string socketPath, unsigned workers = 0, size_t queueCapacity = 64);
+    /**
+     * @brief Starts the workers and accepts connections until the socket fails, then waits for the connections to be
+     * read and the requests queued to be answered.
+     * @return 0 on a clean exit, 1 if the socket couldn't be opened.
+     */
+    int run();
+};
+
+
+#endif //RAILNETWORK_SERVER_H
@@ -0,0 +1,54 @@
+#include <algorithm>
+
+#include "StationIndex.h"
+
+using namespace std;
+
+
+const string& StationIndex::valueOf(const Station &station, StationAttribute attribute) {
+    switch (attribute) {
+        case DISTRICT: return station.district;
+        case MUNICIPALITY: return station.municipality;
+        case TOWNSHIP: return station.township;
+        default: return station.line;
+    }
+}
+
+void StationIndex::add(const Station &station) {
+    if (!ids.emplace(station.name, (unsigned) names.size()).second) return;
+    for (unsigned attribute = 0; attribute < attributes; attribute++)
+        groups[attribute][valueOf(station, (StationAttribute) attribute)].push_back((unsigned) names.size());
+    names.push_back(station.name);
+}
+
+void StationIndex::remove(const Station &station) {
+    auto it = ids.find(station.name);
+    if (it == ids.end()) return;
+    unsigned id = it->second;
+    for (unsigned attribute = 0; attribute < attributes; attribute++) {
+        auto group = groups[attribute].find(valueOf(station, (StationAttribute) attribute));
+        vector<unsigned>& stations = group->second;
+        stations.erase(find(stations.begin(), stations.end(), id));
+        if (stations.empty()) groups[attribute].erase(group);
+    }
+    names[id].clear();
+    ids.erase(it);
+}
+
+const unordered_map<string, vector<unsigned>>& StationIndex::groupsBy(StationAttribute attribute) const {
+    return groups[attribute];
+}
+
+const vector<unsigned>& StationIndex::members(StationAttribute attribute, const string &value) const {
+    static const vector<unsigned> none;
+    auto it = groups[attribute].find(value);
+    return it == groups[attribute].end() ? none : it->second;
+}
+
+const string& StationIndex::name(unsigned id) const {
+    return names[id];
+}
+
+size_t StationIndex::size() const {
+    return ids.size();
+}
@@ -0,0 +1,77 @@
+#ifndef RAILNETWORK_STATIONINDEX_H
+#define RAILNETWORK_STATIONINDEX_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Station.h"
+
+
+enum StationAttribute {
+    DISTRICT,
+    MUNICIPALITY,
+    TOWNSHIP,
+    LINE
+};
+
+/**
+ * @brief Inverted indexes of the stations by district, municipality, township and line, built as they are loaded.
+ * Each station gets a dense id, and each value of an attribute lists the ids of its stations in the order they were
+ * added, so a grouping never has to look a station up by name.
+ */
+class StationIndex {
+    static const unsigned attributes = 4;
+    std::vector<std::string> names; // Of each id, empty once the station is removed
+    std::unordered_map<std::string, unsigned> ids;
+    std::unordered_map<std::string, std::vector<unsigned>> groups[attributes]; // Of each attribute: the ids of each value
+    /**
+     * @brief Returns the value of an attribute of a station.
+     * @param station The station.
+     * @param attribute The attribute.
+     * @return The value.
+     */
+    static const std::string& valueOf(const Station& station, StationAttribute attribute);
+public:
+    /**
+     * @brief Default constructor. Creates an index without stations.
+     */
+    StationIndex() = default;
+    /**
+     * @brief Adds a station to the group of each of its attributes. Does nothing if it was already added.
+     * @param station The station.
+     */
+    void add(const Station& station);
+    /**
+     * @brief Removes a station from its groups, dropping the groups left empty. Its id isn't given to another station.
+     * @param station The station.
+     */
+    void remove(const Station& station);
+    /**
+     * @brief Returns the stations of every value of an attribute.
+     * @param attribute The attribute.
+     * @return The ids of the stations of each value, never empty.
+     */
+    const std::unordered_map<std::string, std::vector<unsigned>>& groupsBy(StationAttribute attribute) const;
+    /**
+     * @brief Returns the stations with a value of an attribute.
+     * @param attribute The attribute.
+     * @param value The value.
+     * @return The ids of the stations, empty if none has it.
+     */
+    const std::vector<unsigned>& members(StationAttribute attribute, const std::string& value) const;
+    /**
+     * @brief Returns the name of a station.
+     * @param id The id of the station.
+     * @return The name, empty if the station was removed.
+     */
+    const std::string& name(unsigned id) const;
+    /**
+     * @brief Returns the number of stations in the index.
+     * @return The number of stations.
+     */
+    size_t size() const;
+};
+
+
+#endif //RAILNETWORK_STATIONINDEX_H
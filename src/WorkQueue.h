@@ -0,0 +1,68 @@
+#ifndef RAILNETWORK_WORKQUEUE_H
+#define RAILNETWORK_WORKQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <queue>
+#include <utility>
+
+/**
+ * @brief A bounded, blocking, multi-producer multi-consumer queue.
+ * Producers block while the queue is full (backpressure) and consumers block while it is empty, until it is closed.
+ * @tparam T The type of the jobs.
+ */
+template <class T>
+class WorkQueue {
+    std::queue<T> jobs;
+    const size_t capacity;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+public:
+    /**
+     * @brief Constructs an empty queue.
+     * @param capacity The maximum number of queued jobs.
+     */
+    explicit WorkQueue(size_t capacity) : capacity(capacity == 0 ? 1 : capacity) {}
+    /**
+     * @brief Adds a job, waiting while the queue is full.
+     * @param job The job to add.
+     * @return False if the queue was closed (the job is dropped).
+     */
+    bool push(T job) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this]() { return closed || jobs.size() < capacity; });
+        if (closed) return false;
+        jobs.push(std::move(job));
+        notEmpty.notify_one();
+        return true;
+    }
+    /**
+     * @brief Takes the oldest job, waiting while the queue is empty.
+     * @param job Where to move the job to.
+     * @return False if the queue was closed and has no more jobs.
+     */
+    bool pop(T& job) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this]() { return closed || !jobs.empty(); });
+        if (jobs.empty()) return false;
+        job = std::move(jobs.front());
+        jobs.pop();
+        notFull.notify_one();
+        return true;
+    }
+    /**
+     * @brief Closes the queue, waking up everyone waiting on it. Queued jobs can still be popped.
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+};
+
+
+#endif //RAILNETWORK_WORKQUEUE_H
@@ -1,13 +1,60 @@
 
 #include "App.h"
+#include "Checks.h"
+#include "Server.h"
+#include <iostream>
 #include <string>
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 using namespace std;
 
-int main() {
+int main(int argc, char* argv[]) {
     //SetConsoleOutputCP(CP_UTF8);
     //setvbuf(stdout, nullptr, _IOFBF, 1000);
 
+    // RailNetwork --server <datasetPath> <socketPath> [workers] [queueCapacity]
+    if (argc >= 4 && string(argv[1]) == "--server") {
+        unsigned workers = argc >= 5 ? stoul(argv[4]) : 0;
+        size_t queueCapacity = argc >= 6 ? stoul(argv[5]) : 64;
+        return Server(argv[2], argv[3], workers, queueCapacity).run();
+    }
+    // RailNetwork --image <datasetPath> <imagePath>
+    if (argc >= 4 && string(argv[1]) == "--image") {
+        string path = argv[2];
+        if (!path.empty() && path.back() != '/' && path.back() != '\\') path += '/';
+        RailManager railMan;
+        railMan.initializeData(path);
+        if (railMan.exportImage(argv[3])) return 0;
+        cerr << "Couldn't write the image " << argv[3] << endl;
+        return 1;
+    }
+    // RailNetwork --attach <imagePath> <socketPath> [workers] [queueCapacity]
+    if (argc >= 4 && string(argv[1]) == "--attach") {
+        NetworkImage image;
+        if (!image.attach(argv[2])) {
+            cerr << "Couldn't attach to the image " << argv[2] << endl;
+            return 1;
+        }
+        unsigned workers = argc >= 5 ? stoul(argv[4]) : 0;
+        size_t queueCapacity = argc >= 6 ? stoul(argv[5]) : 64;
+        return Server(std::move(image), argv[3], workers, queueCapacity).run();
+    }
+    // RailNetwork --check-edits <datasetPath> [edits] [seed]
+    if (argc >= 3 && string(argv[1]) == "--check-edits") {
+        string path = argv[2];
+        if (!path.empty() && path.back() != '/' && path.back() != '\\') path += '/';
+        unsigned edits = argc >= 4 ? stoul(argv[3]) : 300;
+        unsigned seed = argc >= 5 ? stoul(argv[4]) : 42;
+        return Checks::edits(path, edits, seed) == 0 ? 0 : 1;
+    }
+    // RailNetwork --check-workers <datasetPath> [workers]
+    if (argc >= 3 && string(argv[1]) == "--check-workers") {
+        string path = argv[2];
+        if (!path.empty() && path.back() != '/' && path.back() != '\\') path += '/';
+        unsigned workers = argc >= 4 ? stoul(argv[3]) : 8;
+        return Checks::workers(path, workers) == 0 ? 0 : 1;
+    }
     App().start();
     return 0;
 }